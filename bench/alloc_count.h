@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// heap bytes in use, the high water mark and how many blocks were handed out, by replacing the global operator
+// new/delete. include it in the bench's main file only, a program can replace them once.
+namespace bench::heap {
+    inline std::atomic<size_t> current{ 0 };
+    inline std::atomic<size_t> peak{ 0 };
+    inline std::atomic<size_t> allocations{ 0 };
+
+    // each block carries its size in front, padded so the pointer handed out stays aligned.
+    constexpr size_t prefix = alignof(std::max_align_t);
+
+    inline void* allocate(size_t size) {
+        char* block = static_cast<char*>(std::malloc(size + prefix));
+
+        if (block == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        *reinterpret_cast<size_t*>(block) = size;
+        allocations.fetch_add(1);
+        size_t now = current.fetch_add(size) + size;
+        size_t high = peak.load();
+
+        while (now > high && !peak.compare_exchange_weak(high, now)) {
+        }
+
+        return block + prefix;
+    }
+
+    inline void release(void* pointer) {
+        if (pointer == nullptr) {
+            return;
+        }
+
+        char* block = static_cast<char*>(pointer) - prefix;
+        current.fetch_sub(*reinterpret_cast<size_t*>(block));
+        std::free(block);
+    }
+
+    // start a new high water mark from what's in use now. returns that.
+    inline size_t mark() {
+        size_t now = current.load();
+        peak.store(now);
+        return now;
+    }
+}
+
+void* operator new(size_t size) { return bench::heap::allocate(size); }
+void* operator new[](size_t size) { return bench::heap::allocate(size); }
+void operator delete(void* pointer) noexcept { bench::heap::release(pointer); }
+void operator delete[](void* pointer) noexcept { bench::heap::release(pointer); }
+void operator delete(void* pointer, size_t) noexcept { bench::heap::release(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { bench::heap::release(pointer); }
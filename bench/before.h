@@ -0,0 +1,209 @@
+#pragma once
+#include "json.hpp"
+#include "framework.h"
+#include "Button.h"
+#include "Config.h"
+#include "KeyInjector.h"
+#include "Scheduler.h"
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+// the code the benches measure against, as it was before it got replaced, and stand-ins for the parts of the app
+// a bench doesn't link. include it in the bench's main file only, the stand-ins are plain definitions.
+
+// Config.cpp reports skipped buttons through this, macropad.cpp isn't linked in.
+void _DebugString(std::string) {}
+void _DebugString(std::wstring) {}
+
+namespace bench::before {
+    // the input loop: every message copied into an input, status and velocity added together, every byte
+    // through .at().
+    enum class message_type {
+        invalid = 0x0,
+        grid_depressed = 0x90,
+        grid_pressed = 0x90 + 0x7F,
+        grid_page_change_depressed = 0x90 + 0x7F + 0x1,
+        grid_page_change_pressed = 0x90 + 0x7F + 0x2,
+        automap_live_depressed = 0xB0,
+        automap_live_pressed = 0xB0 + 0x7F
+    };
+
+    class input {
+    public:
+        std::vector<unsigned char> message;
+
+        input(std::vector<unsigned char> msg) : message(msg) {}
+
+        message_type type() {
+            message_type kind = static_cast<message_type>(message.at(0) + message.at(2));
+
+            if (kind > message_type::automap_live_pressed || kind < message_type::grid_depressed) {
+                return message_type::invalid;
+            }
+
+            if (message.at(1) % 0x10 == 0x08) {
+                if (kind == message_type::grid_depressed) {
+                    return message_type::grid_page_change_depressed;
+                }
+                else if (kind == message_type::grid_pressed) {
+                    return message_type::grid_page_change_pressed;
+                }
+            }
+
+            return kind;
+        }
+    };
+
+    inline void calculate_xy_fom_keycode(unsigned char keycode, int& x, int& y) {
+        x = keycode / 0x10;
+        y = keycode % 0x10;
+    }
+
+    // the buttons: every one its own heap object behind a ButtonBase pointer, complex macros a std::function.
+    // the scheduler isn't running in the benches, so key tests let go straight away.
+    class ButtonBase {
+        unsigned int color;
+    public:
+        ButtonBase() : color(0) {}
+        virtual ~ButtonBase() {}
+        virtual void execute() = 0;
+        virtual std::wstring to_wstring() = 0;
+        inline void set_color(unsigned int col) { color = col; };
+        inline unsigned int get_color() { return color; };
+    };
+
+    class ButtonSimpleKeycodeTest : public ButtonBase {
+        int keycode;
+    public:
+        ButtonSimpleKeycodeTest(int keycode) : keycode(keycode) {}
+
+        void execute() override
+        {
+            macropad::key_event down = macropad::key_down(static_cast<unsigned short>(keycode));
+            macropad::injector().send(&down, 1);
+
+            if (!macropad::scheduler::schedule(macropad::buttons::key_hold_ms, [](void* context, std::uintptr_t) {
+                static_cast<ButtonSimpleKeycodeTest*>(context)->release();
+            }, this)) {
+                release();
+            }
+        }
+
+        void release()
+        {
+            macropad::key_event up = macropad::key_up(static_cast<unsigned short>(keycode));
+            macropad::injector().send(&up, 1);
+        }
+
+        std::wstring to_wstring() override { return std::to_wstring(keycode); }
+    };
+
+    typedef std::function<void()> ComplexMacroFn;
+
+    class ButtonComplexMacro : public ButtonBase {
+        ComplexMacroFn func;
+    public:
+        ButtonComplexMacro(ComplexMacroFn fun) : func(fun) {}
+        void execute() override { this->func(); }
+        std::wstring to_wstring() override { return L"complex macro"; }
+    };
+
+    class ButtonStringMacro : public ButtonBase {
+        std::wstring string;
+        std::vector<macropad::key_event> events;
+        std::vector<size_t> steps;
+        unsigned int pacing;
+    public:
+        ButtonStringMacro(std::wstring str, unsigned int pacing_ms = 0) : string(str), pacing(pacing_ms)
+        {
+            events.reserve(string.size() * 2);
+            steps.reserve(string.size() + 1);
+
+            for (wchar_t c : string) {
+                steps.push_back(events.size());
+                events.push_back(macropad::unicode_down(static_cast<char16_t>(c)));
+                events.push_back(macropad::unicode_up(static_cast<char16_t>(c)));
+            }
+
+            steps.push_back(events.size());
+        }
+
+        void execute() override { macropad::injector().send(events); }
+        std::wstring to_wstring() override { return string; }
+    };
+
+    // the pages: a vector of heap allocated 8x8 grids of button pointers, no modes.
+    typedef std::array<std::array<ButtonBase*, 8>, 8> launchpad_grid;
+
+    struct device {
+        std::vector<launchpad_grid*> pages;
+        size_t page = 0;
+
+        ButtonBase* get_button(unsigned char key) {
+            if (page >= pages.size()) {
+                return nullptr;
+            }
+
+            if (pages.at(page) == nullptr) {
+                return nullptr;
+            }
+
+            int x, y;
+            calculate_xy_fom_keycode(key, x, y);
+
+            return pages.at(page)->at(x).at(y);
+        }
+    };
+
+    // the config compiler's if-chain over the type names, and the switch in the device that built the button.
+    enum class button_type : unsigned char {
+        key_test,
+        key_string,
+        other
+    };
+
+    inline button_type find_type(const std::string& type) {
+        if (type == "key_test") {
+            return button_type::key_test;
+        }
+        else if (type == "key_string") {
+            return button_type::key_string;
+        }
+        else {
+            return button_type::other;
+        }
+    }
+
+    inline macropad::buttons::Button make(button_type type, const config::compiled_config& source, const config::button_record& record) {
+        switch (type) {
+        case button_type::key_test:
+            return macropad::buttons::ButtonSimpleKeycodeTest(record.keycode);
+        case button_type::key_string:
+            return macropad::buttons::ButtonStringMacro(source.button_text(record), record.pacing);
+        default:
+            return macropad::buttons::Button();
+        }
+    }
+
+    // loadFile, minus ReadFile: 1024 byte chunks, each widened on its own, appended to a wstring that nlohmann
+    // then parsed.
+    inline nlohmann::json load_config(const std::string& file) {
+        std::wstring str = L"";
+        const int buffer_size = 1024;
+
+        for (size_t offset = 0; offset < file.size(); offset += buffer_size) {
+            int bytes = static_cast<int>(std::min<size_t>(buffer_size, file.size() - offset));
+            int buffer_2_size = MultiByteToWideChar(CP_UTF8, 0, file.data() + offset, bytes, nullptr, 0);
+            wchar_t* buffer_2 = new wchar_t[static_cast<size_t>(buffer_2_size) + 1];
+            MultiByteToWideChar(CP_UTF8, 0, file.data() + offset, bytes, buffer_2, buffer_2_size);
+            buffer_2[buffer_2_size] = 0x0;
+            str += std::wstring(buffer_2);
+            delete[] buffer_2;
+        }
+
+        return nlohmann::json::parse(str);
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+
+// just enough harness for the sources in bench/. every bench is one file with its own main(), built together
+// with the macropad sources it measures (the command line is at the top of each file), and prints one line per
+// measurement. nothing here is part of the app.
+namespace bench {
+    // results go through here so the optimizer can't drop the work that made them.
+    inline volatile unsigned long long sink = 0;
+
+    template <typename T>
+    inline void keep(T value) { sink = sink + static_cast<unsigned long long>(value); }
+
+    // ns per call of fn(i), i counting up from 0. the best of a few rounds, the first one warms the caches.
+    template <typename Fn>
+    double ns_per_op(size_t iterations, Fn fn, int rounds = 5) {
+        double best = 1e300;
+
+        for (int round = 0; round < rounds; ++round) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for (size_t i = 0; i < iterations; ++i) {
+                fn(i);
+            }
+
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count() / static_cast<double>(iterations));
+        }
+
+        return best;
+    }
+
+    inline void report(const char* name, double value, const char* unit = "ns") {
+        std::printf("%-48s %12.2f %s\n", name, value, unit);
+    }
+}
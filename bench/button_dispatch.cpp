@@ -0,0 +1,182 @@
+// pressing buttons, the Button value (a variant held in the page table, execute() a switch) against the class
+// hierarchy it replaced: every button its own heap object behind a ButtonBase pointer, execute() a virtual call,
+// complex macros a std::function. then what 10240 buttons take in either form.
+// both run the real actions through an injector: a recording one first to check both sides send the same keys,
+// then one that only counts, so the time is the dispatch and the action and not the recording.
+//
+//   cl /std:c++17 /O2 /EHsc /I macropad bench\button_dispatch.cpp macropad\Button.cpp macropad\Config.cpp
+//      macropad\KeyInjector.cpp macropad\Scheduler.cpp macropad\Executor.cpp macropad\Trace.cpp user32.lib winmm.lib
+#include "framework.h"
+#include "Button.h"
+#include "KeyInjector.h"
+#include "PageTable.h"
+#include "Scheduler.h"
+#include "alloc_count.h"
+#include "before.h"
+#include "bench.h"
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    namespace before = bench::before;
+
+    class counting_injector : public macropad::KeyInjector {
+    public:
+        size_t send(const macropad::key_event* events, size_t count) override
+        {
+            bench::keep(count == 0 ? 0 : events[count - 1].code);
+            return count;
+        }
+    };
+
+    constexpr size_t mode_count = 4;
+    constexpr size_t page_count = 40;
+    constexpr size_t button_count = mode_count * page_count * 64;
+
+    void complex_macro() { bench::keep(1); }
+
+    // what config_load builds: every other button a string, now and then a complex macro.
+    std::wstring button_text(size_t i) { return L"text " + std::to_wstring(i); }
+    bool is_complex(size_t i) { return i % 64 == 63; }
+
+    midi_device::page_table<macropad::buttons::Button>* make_table() {
+        auto* table = new midi_device::page_table<macropad::buttons::Button>(mode_count, page_count);
+
+        for (size_t i = 0; i < button_count; ++i) {
+            macropad::buttons::Button button;
+
+            if (is_complex(i)) {
+                button = macropad::buttons::ButtonComplexMacro(complex_macro);
+            }
+            else if (i % 2 == 0) {
+                button = macropad::buttons::ButtonSimpleKeycodeTest(static_cast<int>('A' + i % 26));
+            }
+            else {
+                button = macropad::buttons::ButtonStringMacro(button_text(i));
+            }
+
+            button.set_color(static_cast<unsigned int>(i % 0x80));
+            table->put(i, std::move(button));
+        }
+
+        return table;
+    }
+
+    // the old pages were arrays of pointers, flattened here the same way.
+    std::vector<before::ButtonBase*> make_pointers() {
+        std::vector<before::ButtonBase*> buttons(button_count);
+
+        for (size_t i = 0; i < button_count; ++i) {
+            if (is_complex(i)) {
+                buttons[i] = new before::ButtonComplexMacro([]() { complex_macro(); });
+            }
+            else if (i % 2 == 0) {
+                buttons[i] = new before::ButtonSimpleKeycodeTest(static_cast<int>('A' + i % 26));
+            }
+            else {
+                buttons[i] = new before::ButtonStringMacro(button_text(i));
+            }
+
+            buttons[i]->set_color(static_cast<unsigned int>(i % 0x80));
+        }
+
+        return buttons;
+    }
+
+    bool same_events(const macropad::RecordingInjector& a, const macropad::RecordingInjector& b) {
+        std::vector<macropad::RecordingInjector::entry> x = a.events();
+        std::vector<macropad::RecordingInjector::entry> y = b.events();
+
+        if (x.size() != y.size()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < x.size(); ++i) {
+            if (x[i].event.kind != y[i].event.kind || x[i].event.up != y[i].event.up || x[i].event.code != y[i].event.code) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+int main() {
+    size_t base = bench::heap::mark();
+    std::unique_ptr<midi_device::page_table<macropad::buttons::Button>> table(make_table());
+    size_t table_bytes = bench::heap::current - base;
+
+    base = bench::heap::mark();
+    std::vector<before::ButtonBase*> pointers = make_pointers();
+    size_t pointer_bytes = bench::heap::current - base;
+
+    // presses land anywhere, shuffled so neither side gets to learn the order.
+    constexpr size_t press_count = 1 << 16;
+    std::mt19937 random(1234);
+    std::vector<unsigned int> presses(press_count);
+
+    for (unsigned int& press : presses) {
+        press = static_cast<unsigned int>(random() % button_count);
+    }
+
+    auto press_button = [&](size_t i) {
+        size_t index = presses[i];
+        macropad::buttons::Button* button = table->get(index / (page_count * 64), index / 64 % page_count, index % 64);
+
+        if (button != nullptr) {
+            button->execute();
+            bench::keep(button->get_color());
+        }
+    };
+
+    auto press_pointer = [&](size_t i) {
+        before::ButtonBase* button = pointers[presses[i]];
+
+        if (button != nullptr) {
+            button->execute();
+            bench::keep(button->get_color());
+        }
+    };
+
+    // one pass each through a recorder first, both have to send exactly the same keys.
+    macropad::RecordingInjector recorded_variant;
+    macropad::RecordingInjector recorded_virtual;
+    constexpr size_t checked_presses = 4096;
+
+    macropad::set_injector(&recorded_variant);
+    for (size_t i = 0; i < checked_presses; ++i) {
+        press_button(i);
+    }
+
+    macropad::set_injector(&recorded_virtual);
+    for (size_t i = 0; i < checked_presses; ++i) {
+        press_pointer(i);
+    }
+
+    bool same = same_events(recorded_variant, recorded_virtual) && recorded_variant.size() > 0;
+
+    counting_injector counting;
+    macropad::set_injector(&counting);
+
+    double variant = bench::ns_per_op(press_count, press_button);
+    double virtual_call = bench::ns_per_op(press_count, press_pointer);
+
+    macropad::set_injector(nullptr);
+
+    std::printf("%zu buttons, %zu presses, %zu keys recorded, %s\n", button_count, press_count, recorded_variant.size(),
+        same ? "same keys both ways" : "KEYS DIFFER");
+    bench::report("press: Button variant in page_table", variant);
+    bench::report("press: ButtonBase virtual (before)", virtual_call);
+    bench::report("memory: page_table of Button", table_bytes / 1024.0, "KiB");
+    bench::report("memory: ButtonBase objects + pointers (before)", pointer_bytes / 1024.0, "KiB");
+    bench::report("per button: Button", static_cast<double>(table_bytes) / button_count, "bytes");
+    bench::report("per button: ButtonBase (before)", static_cast<double>(pointer_bytes) / button_count, "bytes");
+
+    for (before::ButtonBase* button : pointers) {
+        delete button;
+    }
+
+    return same ? 0 : 1;
+}
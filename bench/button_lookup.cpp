@@ -0,0 +1,138 @@
+// pad release to button, the flat page table (decode_input, then one index into page_table) against what the
+// input loop used to do: copy the message, work out its type, bounds check the page, split the note into row and
+// column with a divide and a modulo, then .at() through a vector of heap allocated 8x8 grids of button pointers.
+// both read the button's color afterwards, the way the LED feedback does.
+//
+//   cl /std:c++17 /O2 /EHsc /I macropad bench\button_lookup.cpp macropad\KeyInjector.cpp macropad\Scheduler.cpp
+//      macropad\Trace.cpp user32.lib winmm.lib
+#include "framework.h"
+#include "InputEvent.h"
+#include "Launchpad.h"
+#include "before.h"
+#include "bench.h"
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+    namespace before = bench::before;
+
+    constexpr size_t page_count = 40;
+
+    // pad releases on the S (note on, velocity 0), the page and mode changing every so often.
+    struct press {
+        RtMidiEvent event;
+        unsigned char page;
+        midi_device::launchpad::mode mode;
+    };
+
+    std::vector<press> make_presses(size_t count) {
+        std::mt19937 random(1234);
+        std::vector<press> presses;
+        presses.reserve(count);
+
+        unsigned char page = 0;
+        midi_device::launchpad::mode mode = midi_device::launchpad::mode::session;
+
+        for (size_t i = 0; i < count; ++i) {
+            if (i % 64 == 0) {
+                page = static_cast<unsigned char>(random() % page_count);
+                mode = static_cast<midi_device::launchpad::mode>(static_cast<size_t>(midi_device::launchpad::mode::session) + random() % midi_device::launchpad::mode_count);
+            }
+
+            unsigned char key = static_cast<unsigned char>(0x10 * (random() % 8) + random() % 8);
+            presses.push_back(press{ RtMidiEvent{ { 0x90, key, 0x00 }, 3, 0.0 }, page, mode });
+        }
+
+        return presses;
+    }
+}
+
+int main() {
+    constexpr size_t press_count = 1 << 16;
+    std::vector<press> presses = make_presses(press_count);
+
+    // every pad of every page and mode has a button, a few pads left empty the way configs tend to be.
+    midi_device::launchpad::launchpad_pages table(midi_device::launchpad::mode_count, page_count);
+
+    for (size_t cell = 0; cell < table.size(); ++cell) {
+        if (cell % 7 != 0) {
+            midi_device::launchpad::config::Button button = midi_device::launchpad::config::ButtonSimpleKeycodeTest(static_cast<int>('A' + cell % 26));
+            button.set_color(static_cast<unsigned int>(cell % 0x80));
+            table.put(cell, std::move(button));
+        }
+    }
+
+    // the old loop had no modes, just the pages.
+    before::device old;
+    std::vector<std::unique_ptr<before::launchpad_grid>> grids;
+    std::vector<std::unique_ptr<before::ButtonBase>> buttons;
+
+    for (size_t page = 0; page < page_count; ++page) {
+        grids.push_back(std::make_unique<before::launchpad_grid>());
+
+        for (size_t cell = 0; cell < midi_device::launchpad::launchpad_pages::page_slots; ++cell) {
+            before::ButtonBase* button = nullptr;
+
+            if ((page * midi_device::launchpad::launchpad_pages::page_slots + cell) % 7 != 0) {
+                buttons.push_back(std::make_unique<before::ButtonSimpleKeycodeTest>(static_cast<int>('A' + cell % 26)));
+                button = buttons.back().get();
+                button->set_color(static_cast<unsigned int>(cell % 0x80));
+            }
+
+            grids.back()->at(cell / 8).at(cell % 8) = button;
+        }
+
+        old.pages.push_back(grids.back().get());
+    }
+
+    // the old loop got its messages as vectors from getMessage.
+    std::vector<std::vector<unsigned char>> messages;
+    messages.reserve(presses.size());
+
+    for (const press& p : presses) {
+        messages.emplace_back(p.event.bytes, p.event.bytes + p.event.size);
+    }
+
+    double flat = bench::ns_per_op(press_count, [&](size_t i) {
+        const midi_device::input_event input = midi_device::decode_input(midi_device::launchpad::input_keys, presses[i].event);
+
+        if (input.kind != midi_device::input_kind::grid_released) {
+            return;
+        }
+
+        const midi_device::launchpad::config::Button* button = table.get(midi_device::launchpad::mode_index(presses[i].mode), presses[i].page, input.slot);
+        bench::keep(button == nullptr ? 0 : button->get_color());
+    });
+
+    double grid = bench::ns_per_op(press_count, [&](size_t i) {
+        std::vector<unsigned char> message = messages[i];
+
+        if (static_cast<before::message_type>(message.at(0) + message.at(2)) != before::message_type::grid_depressed) {
+            return;
+        }
+
+        old.page = presses[i].page;
+        before::ButtonBase* button = old.get_button(message.at(1));
+        bench::keep(button == nullptr ? 0 : button->get_color());
+    });
+
+    // the same lookup without the copy in front of it, so the table is measured on its own.
+    double grid_only = bench::ns_per_op(press_count, [&](size_t i) {
+        const std::vector<unsigned char>& message = messages[i];
+
+        if (static_cast<before::message_type>(message.at(0) + message.at(2)) != before::message_type::grid_depressed) {
+            return;
+        }
+
+        old.page = presses[i].page;
+        before::ButtonBase* button = old.get_button(message.at(1));
+        bench::keep(button == nullptr ? 0 : button->get_color());
+    });
+
+    std::printf("%zu presses, %zu pages\n", press_count, page_count);
+    bench::report("decode_input + page_table::get", flat);
+    bench::report("message copy + grid pointers (before)", grid);
+    bench::report("grid pointers, no copy (before)", grid_only);
+    return 0;
+}
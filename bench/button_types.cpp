@@ -0,0 +1,100 @@
+// going from a config "type" name to a button, 10240 of them: the registry (a scan of its table, then the type's
+// make) against the if-chain the compiler used to have, which compared the name against each type in turn and
+// left a switch in the device to build the button.
+// both sides build the same buttons from the same records, so the difference is the dispatch.
+//
+//   cl /std:c++17 /O2 /EHsc /I macropad bench\button_types.cpp macropad\Config.cpp macropad\Button.cpp
+//      macropad\KeyInjector.cpp macropad\Scheduler.cpp macropad\Executor.cpp macropad\Trace.cpp user32.lib winmm.lib
+#include "framework.h"
+#include "Button.h"
+#include "Config.h"
+#include "before.h"
+#include "bench.h"
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    namespace before = bench::before;
+
+    constexpr size_t button_count = 10240;
+
+    struct button_input {
+        std::string type;
+        config::button_record record;
+    };
+
+    // shuffled so neither side gets to learn the order. one in 64 is a type nobody has.
+    std::vector<button_input> make_buttons(config::compiled_config& source) {
+        std::mt19937 random(1234);
+        std::vector<button_input> buttons;
+        buttons.reserve(button_count);
+
+        for (size_t i = 0; i < button_count; ++i) {
+            button_input button{};
+            unsigned int pick = random() % 64;
+
+            if (pick == 0) {
+                button.type = "key_tset";
+            }
+            else if (pick % 2 == 0) {
+                button.type = "key_test";
+                button.record.keycode = 'A' + static_cast<int>(i % 26);
+            }
+            else {
+                std::wstring text = L"text " + std::to_wstring(i);
+
+                button.type = "key_string";
+                button.record.text_offset = static_cast<unsigned int>(source.text.size());
+                button.record.text_length = static_cast<unsigned int>(text.size());
+                source.text.insert(source.text.end(), text.begin(), text.end());
+            }
+
+            buttons.push_back(std::move(button));
+        }
+
+        return buttons;
+    }
+}
+
+int main() {
+    config::compiled_config source;
+    std::vector<button_input> buttons = make_buttons(source);
+
+    double registry_lookup = bench::ns_per_op(button_count, [&](size_t i) {
+        bench::keep(macropad::buttons::find_type(buttons[i].type));
+    });
+
+    double before_lookup = bench::ns_per_op(button_count, [&](size_t i) {
+        bench::keep(before::find_type(buttons[i].type));
+    });
+
+    double registry_make = bench::ns_per_op(button_count, [&](size_t i) {
+        int type = macropad::buttons::find_type(buttons[i].type);
+
+        if (type < 0) {
+            return;
+        }
+
+        config::button_record record = buttons[i].record;
+        record.type = static_cast<unsigned char>(type);
+        bench::keep(macropad::buttons::make(source, record).empty());
+    });
+
+    double before_make = bench::ns_per_op(button_count, [&](size_t i) {
+        before::button_type type = before::find_type(buttons[i].type);
+
+        if (type == before::button_type::other) {
+            return;
+        }
+
+        bench::keep(before::make(type, source, buttons[i].record).empty());
+    });
+
+    std::printf("%zu buttons\n", button_count);
+    bench::report("type name: registry", registry_lookup);
+    bench::report("type name: if-chain (before)", before_lookup);
+    bench::report("name to button: registry", registry_make);
+    bench::report("name to button: if-chain + switch (before)", before_make);
+    return 0;
+}
@@ -0,0 +1,108 @@
+// config.json loading. parsing straight off the UTF-8 bytes against the way loadFile used to do it: 1024 byte
+// chunks, each widened on its own, appended to a wstring that nlohmann then parsed. then config::compile, which
+// never builds the DOM, and what each leaves behind once loaded.
+// everything starts from the file already in memory, so this is conversion and parsing, not the disk.
+//
+//   cl /std:c++17 /O2 /EHsc /I macropad bench\config_load.cpp macropad\Config.cpp macropad\Button.cpp
+//      macropad\KeyInjector.cpp macropad\Scheduler.cpp macropad\Executor.cpp macropad\Trace.cpp user32.lib winmm.lib
+#include "json.hpp"
+#include "framework.h"
+#include "Config.h"
+#include "alloc_count.h"
+#include "before.h"
+#include "bench.h"
+#include <string>
+
+namespace {
+    // 10240 buttons: 4 modes of 40 pages, every pad used, every other one a string.
+    std::string make_config() {
+        std::string json = "{\"devices\":{\"Launchpad_S\":{";
+
+        for (int mode = 0; mode < 4; ++mode) {
+            json += std::string(mode == 0 ? "" : ",") + "\"" + config::mode_names[mode] + "\":{";
+
+            for (int page = 0; page < 40; ++page) {
+                json += std::string(page == 0 ? "" : ",") + "\"" + std::to_string(page) + "\":[";
+
+                for (int slot = 0; slot < 64; ++slot) {
+                    json += slot == 0 ? "{" : ",{";
+                    json += "\"position\":[" + std::to_string(slot / 8) + "," + std::to_string(slot % 8) + "],";
+
+                    if (slot % 2 == 0) {
+                        json += "\"type\":\"key_test\",\"data\":" + std::to_string(0x41 + slot / 2) + "}";
+                    }
+                    else {
+                        json += "\"type\":\"key_string\",\"data\":\"page " + std::to_string(page) + " pad " + std::to_string(slot) + " \\u00e9\"}";
+                    }
+                }
+
+                json += "]";
+            }
+
+            json += "}";
+        }
+
+        return json + "}}}";
+    }
+}
+
+int main() {
+    const std::string file = make_config();
+    std::printf("config.json: %zu bytes\n", file.size());
+
+    double bytes_ms = bench::ns_per_op(1, [&](size_t) {
+        nlohmann::json dom = nlohmann::json::parse(file.begin(), file.end());
+        bench::keep(dom.size());
+    }) / 1e6;
+
+    double before_ms = bench::ns_per_op(1, [&](size_t) {
+        nlohmann::json dom = bench::before::load_config(file);
+        bench::keep(dom.size());
+    }) / 1e6;
+
+    size_t base = bench::heap::mark();
+    {
+        nlohmann::json dom = nlohmann::json::parse(file.begin(), file.end());
+    }
+    size_t bytes_peak = bench::heap::peak - base;
+
+    base = bench::heap::mark();
+    {
+        nlohmann::json dom = bench::before::load_config(file);
+    }
+    size_t before_peak = bench::heap::peak - base;
+
+    double compile_ms = bench::ns_per_op(1, [&](size_t) {
+        config::compiled_config result;
+        config::compile(file.data(), file.size(), result);
+        bench::keep(result.buttons.size());
+    }) / 1e6;
+
+    base = bench::heap::mark();
+    size_t compile_peak = 0;
+    size_t compile_resident = 0;
+    {
+        config::compiled_config result;
+        config::compile(file.data(), file.size(), result);
+        compile_peak = bench::heap::peak - base;
+        compile_resident = bench::heap::current - base;
+    }
+
+    // the DOM the devices used to walk stayed loaded for the life of the process.
+    base = bench::heap::mark();
+    size_t dom_resident = 0;
+    {
+        nlohmann::json dom = nlohmann::json::parse(file.begin(), file.end());
+        dom_resident = bench::heap::current - base;
+    }
+
+    bench::report("parse UTF-8 bytes", bytes_ms, "ms");
+    bench::report("chunked widen + parse (before)", before_ms, "ms");
+    bench::report("parse UTF-8 bytes, peak heap", bytes_peak / 1024.0, "KiB");
+    bench::report("chunked widen + parse, peak heap (before)", before_peak / 1024.0, "KiB");
+    bench::report("compile (SAX, no DOM)", compile_ms, "ms");
+    bench::report("compile, peak heap", compile_peak / 1024.0, "KiB");
+    bench::report("loaded: compiled_config", compile_resident / 1024.0, "KiB");
+    bench::report("loaded: DOM (before)", dom_resident / 1024.0, "KiB");
+    return 0;
+}
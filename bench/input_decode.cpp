@@ -0,0 +1,80 @@
+// pad input decoding, the table decode (InputEvent.h) against what the input loop used to do: copy the message
+// into an input object and add status and velocity bytes together, every byte through .at().
+//
+//   cl /std:c++17 /O2 /EHsc /I macropad bench\input_decode.cpp
+#include "framework.h"
+#include "InputEvent.h"
+#include "Launchpad.h"
+#include "before.h"
+#include "bench.h"
+#include <random>
+#include <vector>
+
+namespace {
+    namespace before = bench::before;
+
+    // what a session of pad mashing looks like off the S: pads and the page column pressed and released, a
+    // few top row buttons, clock in between.
+    std::vector<RtMidiEvent> make_events(size_t count) {
+        std::mt19937 random(1234);
+        std::vector<RtMidiEvent> events;
+        events.reserve(count);
+
+        while (events.size() < count) {
+            unsigned int pick = random() % 16;
+            unsigned char row = static_cast<unsigned char>(random() % 8);
+            unsigned char column = static_cast<unsigned char>(random() % 9);
+
+            if (pick == 0) {
+                events.push_back(RtMidiEvent{ { 0xF8, 0, 0 }, 1, 0.0 });
+            }
+            else if (pick == 1) {
+                events.push_back(RtMidiEvent{ { 0xB0, static_cast<unsigned char>(104 + row), 0x7F }, 3, 0.0 });
+            }
+            else {
+                unsigned char key = static_cast<unsigned char>(0x10 * row + column);
+                events.push_back(RtMidiEvent{ { 0x90, key, 0x7F }, 3, 0.0 });
+                events.push_back(RtMidiEvent{ { 0x90, key, 0x00 }, 3, 0.0 });
+            }
+        }
+
+        events.resize(count);
+        return events;
+    }
+}
+
+int main() {
+    constexpr size_t event_count = 1 << 16;
+    std::vector<RtMidiEvent> events = make_events(event_count);
+
+    // the old loop got its messages as vectors from getMessage.
+    std::vector<std::vector<unsigned char>> messages;
+    messages.reserve(events.size());
+
+    for (const RtMidiEvent& event : events) {
+        messages.emplace_back(event.bytes, event.bytes + event.size);
+    }
+
+    double table = bench::ns_per_op(event_count, [&](size_t i) {
+        midi_device::input_event input = midi_device::decode_input(midi_device::launchpad::input_keys, events[i]);
+        bench::keep(static_cast<unsigned int>(input.kind) + input.slot);
+    });
+
+    double copied = bench::ns_per_op(event_count, [&](size_t i) {
+        // clock is one byte and .at(2) throws on it, the old loop filtered it out before getting here.
+        if (messages[i].size() != 3) {
+            bench::keep(0);
+            return;
+        }
+
+        before::input input(messages[i]);
+        before::message_type kind = input.type();
+        // then the row and column out of the note.
+        unsigned char key = input.message.at(1);
+        bench::keep(static_cast<unsigned int>(kind) + key / 0x10 * 8 + key % 0x10);
+    });
+
+    bench::report("decode_input (table)", table);
+    bench::report("input copy + message_type (before)", copied);
+    return 0;
+}
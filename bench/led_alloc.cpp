@@ -0,0 +1,192 @@
+// LED updates end to end without a device: presses, fades, pulses, a progress bar and page switches composed by the
+// layers, diffed by the framebuffer, built into messages (the S's 3 byte messages and rapid update, the MK2's
+// led_batch frames and led_setAll) and queued and swapped the way led_writer does. after one warm-up pass that
+// sizes the buffers, none of it may touch the heap. fails if it does.
+//
+//   cl /std:c++17 /O2 /EHsc /I macropad bench\led_alloc.cpp
+#include "framework.h"
+#include "LedFramebuffer.h"
+#include "LedLayers.h"
+#include "LedWriter.h"
+#include "Launchpad.h"
+#include "LaunchpadMk2.h"
+#include "alloc_count.h"
+#include "bench.h"
+#include <chrono>
+
+namespace {
+    typedef std::chrono::steady_clock clock_type;
+
+    constexpr size_t frame_count = 4096;
+    // every animation tick is this far apart, so fades and pulses actually move.
+    constexpr std::chrono::milliseconds tick(5);
+
+    // the writer's side: queued filled under the lock, swapped out and sent.
+    struct writer_queues {
+        midi_device::message_queue queued;
+        midi_device::message_queue sending;
+
+        void send() {
+            sending.swap(queued);
+            sending.for_each([](const unsigned char* message, size_t size) {
+                bench::keep(message[size - 1]);
+            });
+            sending.clear();
+        }
+    };
+
+    size_t pad_cell(size_t i) { return midi_device::led_grid_cell(i / 8 % 8, i % 8); }
+
+    namespace s {
+        using namespace midi_device::launchpad;
+
+        struct device {
+            midi_device::led_layers<unsigned char, velocity_mix> layers;
+            midi_device::led_framebuffer<unsigned char> leds;
+            writer_queues queues;
+        };
+
+        // as Launchpad::sendLed.
+        void send_led(writer_queues& queues, size_t cell, unsigned char velocity) {
+            if (midi_device::led_is_control(cell)) {
+                queues.queued.push(commands::controller_change(static_cast<unsigned char>(0x68 + midi_device::led_cell_control(cell)), velocity));
+            }
+            else {
+                queues.queued.push(commands::led_on(commands::calculate_grid(
+                    static_cast<unsigned char>(midi_device::led_cell_row(cell)), static_cast<unsigned char>(midi_device::led_cell_column(cell))), velocity));
+            }
+        }
+
+        void frame(device& d, size_t i, clock_type::time_point now) {
+            d.layers.press(pad_cell(i), commands::vel_red_full);
+            d.layers.release(pad_cell(i + 63), release_fade_ms, now);
+
+            // a page switch now and then, drawn with rapid update and flipped in like presentFrame.
+            if (i % 64 == 0) {
+                d.layers.fill_base(commands::vel_off_off);
+
+                for (size_t slot = 0; slot < 64; ++slot) {
+                    d.layers.set_base(pad_cell(slot), static_cast<unsigned char>(commands::calculate_velocity(static_cast<int>((slot + i) % 4), 1)));
+                }
+
+                d.layers.pulse(pad_cell(i + 7), commands::vel_off_off, commands::vel_yellow_full, reload_pulse_period_ms, reload_pulse_ms, now);
+                d.layers.timed_progress(midi_device::led_control_cell(0), midi_device::led_columns, commands::vel_green_full, 200, now);
+                d.layers.compose(d.leds, now);
+
+                for (size_t cell = 0; cell < midi_device::led_cells; cell += 2) {
+                    d.queues.queued.push(commands::rapid_update(
+                        d.leds.get(cell) & ~commands::velocity_flags, d.leds.get(cell + 1) & ~commands::velocity_flags));
+                }
+
+                d.leds.commit();
+                d.queues.queued.push(commands::controller_change(0x00, commands::buffer_select(1, 0, true)));
+            }
+            else {
+                d.layers.compose(d.leds, now);
+                d.leds.present([&](size_t cell, unsigned char color) { send_led(d.queues, cell, color); });
+            }
+
+            d.queues.send();
+        }
+    }
+
+    namespace mk2 {
+        using namespace midi_device::launchpadmk2;
+
+        struct device {
+            midi_device::led_layers<unsigned int, color_mix> layers;
+            midi_device::led_framebuffer<unsigned int> leds;
+            commands::led_batch led_out;
+            writer_queues queues;
+        };
+
+        // as LaunchpadMk2::presentLeds.
+        void present(device& d) {
+            d.leds.present([&](size_t cell, unsigned int color) {
+                unsigned char key = midi_device::led_is_control(cell)
+                    ? static_cast<unsigned char>(104 + midi_device::led_cell_control(cell))
+                    : commands::calculate_grid(static_cast<unsigned char>(midi_device::led_cell_row(cell)), static_cast<unsigned char>(midi_device::led_cell_column(cell)));
+
+                d.led_out.add(key, color);
+            });
+
+            d.led_out.flush([&](const unsigned char* message, size_t size) {
+                d.queues.queued.push(message, size);
+            });
+        }
+
+        void frame(device& d, size_t i, clock_type::time_point now) {
+            d.layers.press(pad_cell(i), commands::palette(49));
+            d.layers.release(pad_cell(i + 63), release_fade_ms, now);
+
+            // a page switch now and then: clear it all, then a page of RGB and palette colors.
+            if (i % 64 == 0) {
+                d.queues.queued.push(commands::led_setAll(0));
+                d.leds.assume(commands::palette(0));
+                d.layers.fill_base(commands::palette(0));
+
+                for (size_t slot = 0; slot < 64; ++slot) {
+                    d.layers.set_base(pad_cell(slot), slot % 2 == 0 ? commands::palette(static_cast<unsigned char>(slot + i)) : 0x221100 + static_cast<unsigned int>(slot));
+                }
+
+                d.layers.pulse(pad_cell(i + 7), commands::palette(0), 0x3F3F00, reload_pulse_period_ms, reload_pulse_ms, now);
+                d.layers.timed_progress(midi_device::led_control_cell(0), midi_device::led_columns, commands::palette(21), 200, now);
+            }
+
+            // frames split to the configured sysex size every other page.
+            d.led_out.set_max_size(i / 64 % 2 == 0 ? commands::led_batch_max_size : 64);
+            d.layers.compose(d.leds, now);
+            present(d);
+            d.queues.send();
+        }
+    }
+
+    template <typename Device, typename Frame>
+    size_t count_allocations(Device& d, Frame frame, clock_type::time_point& now) {
+        size_t before = bench::heap::allocations.load();
+
+        for (size_t i = 0; i < frame_count; ++i) {
+            frame(d, i, now);
+            now += tick;
+        }
+
+        return bench::heap::allocations.load() - before;
+    }
+}
+
+int main() {
+    clock_type::time_point now = clock_type::now();
+
+    s::device s_device;
+    mk2::device mk2_device;
+
+    // the first pass grows the queues to what a whole page takes, that's allowed once.
+    count_allocations(s_device, s::frame, now);
+    count_allocations(mk2_device, mk2::frame, now);
+
+    size_t s_allocations = count_allocations(s_device, s::frame, now);
+    size_t mk2_allocations = count_allocations(mk2_device, mk2::frame, now);
+
+    double s_time = bench::ns_per_op(frame_count, [&](size_t i) {
+        s::frame(s_device, i, now);
+        now += tick;
+    });
+
+    double mk2_time = bench::ns_per_op(frame_count, [&](size_t i) {
+        mk2::frame(mk2_device, i, now);
+        now += tick;
+    });
+
+    std::printf("%zu frames each, a page switch every 64\n", frame_count);
+    bench::report("S: allocations after warm-up", static_cast<double>(s_allocations), "");
+    bench::report("MK2: allocations after warm-up", static_cast<double>(mk2_allocations), "");
+    bench::report("S: compose + present + queue, per frame", s_time);
+    bench::report("MK2: compose + present + queue, per frame", mk2_time);
+
+    if (s_allocations + mk2_allocations > 0) {
+        std::printf("LED UPDATES ALLOCATE\n");
+        return 1;
+    }
+
+    return 0;
+}
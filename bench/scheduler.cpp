@@ -0,0 +1,162 @@
+// timers firing on time with a lot of them pending: how far from its deadline each callback runs.
+// first 500 one-shot timers all scheduled at once, 1 to 500 ms out, so some of them go through level 1 of the wheel.
+// then 250 chains rescheduling themselves every 1 to 40 ms the way paced typing does, each step measured against
+// the time it asked for. the wheel rounds deadlines to the nearest 1 ms tick, so up to half a ms early is by design.
+// last, one thread just sleeping until a deadline, over and over: what the OS itself manages, no timer does better.
+//
+//   cl /std:c++17 /O2 /EHsc /I macropad bench\scheduler.cpp macropad\Scheduler.cpp macropad\Trace.cpp winmm.lib
+#include "framework.h"
+#include "Scheduler.h"
+#include "bench.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+    typedef std::chrono::steady_clock clock_type;
+
+    // one per timer, written on the scheduler thread, read once everything has fired.
+    struct shot {
+        clock_type::time_point due;
+        double error_ms;
+        std::atomic<bool> fired{ false };
+    };
+
+    void record(void* context, std::uintptr_t) {
+        shot* s = static_cast<shot*>(context);
+        s->error_ms = std::chrono::duration<double, std::milli>(clock_type::now() - s->due).count();
+        s->fired.store(true, std::memory_order_release);
+    }
+
+    struct chain {
+        clock_type::time_point due;
+        unsigned int period_ms;
+        size_t step;
+        std::vector<double>* errors;
+        std::atomic<bool> done{ false };
+    };
+
+    constexpr size_t chain_steps = 40;
+
+    void chain_step(void* context, std::uintptr_t) {
+        chain* c = static_cast<chain*>(context);
+        clock_type::time_point now = clock_type::now();
+        c->errors->push_back(std::chrono::duration<double, std::milli>(now - c->due).count());
+
+        if (++c->step == chain_steps) {
+            c->done.store(true, std::memory_order_release);
+            return;
+        }
+
+        // the next step period_ms from now, the way ButtonStringMacro::type_step does it.
+        c->due = clock_type::now() + std::chrono::milliseconds(c->period_ms);
+
+        if (!macropad::scheduler::schedule(c->period_ms, chain_step, c)) {
+            c->done.store(true, std::memory_order_release);
+        }
+    }
+
+    void report_errors(const char* name, std::vector<double> errors) {
+        std::sort(errors.begin(), errors.end(), [](double a, double b) { return std::fabs(a) < std::fabs(b); });
+
+        double sum = 0;
+        for (double error : errors) {
+            sum += std::fabs(error);
+        }
+
+        std::printf("%s: %zu callbacks\n", name, errors.size());
+        bench::report("  mean |error|", sum / errors.size(), "ms");
+        bench::report("  p99 |error|", std::fabs(errors[errors.size() * 99 / 100]), "ms");
+        bench::report("  max |error|", std::fabs(errors.back()), "ms");
+    }
+}
+
+int main() {
+    macropad::scheduler::start();
+    std::mt19937 random(1234);
+    bool all_fired = true;
+
+    {
+        constexpr size_t shot_count = 500;
+        std::vector<shot> shots(shot_count);
+
+        for (shot& s : shots) {
+            unsigned int delay = 1 + random() % 500;
+            s.due = clock_type::now() + std::chrono::milliseconds(delay);
+            all_fired = macropad::scheduler::schedule(delay, record, &s) && all_fired;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+
+        std::vector<double> errors;
+        for (const shot& s : shots) {
+            if (!s.fired.load(std::memory_order_acquire)) {
+                all_fired = false;
+                continue;
+            }
+
+            errors.push_back(s.error_ms);
+        }
+
+        report_errors("500 one-shot timers, 1-500 ms", std::move(errors));
+    }
+
+    {
+        constexpr size_t chain_count = 250;
+        std::vector<std::vector<double>> errors(chain_count);
+        std::vector<chain> chains(chain_count);
+
+        for (size_t i = 0; i < chain_count; ++i) {
+            chains[i].period_ms = 1 + random() % 40;
+            chains[i].step = 0;
+            chains[i].errors = &errors[i];
+            errors[i].reserve(chain_steps);
+
+            unsigned int delay = random() % 40;
+            chains[i].due = clock_type::now() + std::chrono::milliseconds(delay);
+            all_fired = macropad::scheduler::schedule(delay, chain_step, &chains[i]) && all_fired;
+        }
+
+        // the longest chain is 40 steps of 40 ms.
+        std::this_thread::sleep_for(std::chrono::milliseconds(40 + chain_steps * 40 + 200));
+
+        std::vector<double> all;
+        for (size_t i = 0; i < chain_count; ++i) {
+            // a chain still going is still writing its errors, leave it be.
+            if (!chains[i].done.load(std::memory_order_acquire) || errors[i].size() != chain_steps) {
+                all_fired = false;
+                continue;
+            }
+
+            all.insert(all.end(), errors[i].begin(), errors[i].end());
+        }
+
+        report_errors("250 chains rescheduling every 1-40 ms", std::move(all));
+    }
+
+    macropad::scheduler::stop();
+
+    {
+        constexpr size_t sleep_count = 2000;
+        std::vector<double> errors;
+        errors.reserve(sleep_count);
+
+        for (size_t i = 0; i < sleep_count; ++i) {
+            clock_type::time_point due = clock_type::now() + std::chrono::milliseconds(1 + random() % 5);
+            std::this_thread::sleep_until(due);
+            errors.push_back(std::chrono::duration<double, std::milli>(clock_type::now() - due).count());
+        }
+
+        report_errors("sleep_until on one thread, 1-5 ms (the floor)", std::move(errors));
+    }
+
+    if (!all_fired) {
+        std::printf("TIMERS MISSING\n");
+    }
+
+    return all_fired ? 0 : 1;
+}
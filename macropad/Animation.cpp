@@ -0,0 +1,155 @@
+#ifdef _WIN32
+#include "framework.h"
+#endif
+#include "Animation.h"
+#include "Trace.h"
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace macropad::animation {
+    namespace {
+        std::array<target*, max_targets> targets;
+        size_t target_count = 0;
+
+        std::chrono::duration<double> interval;
+        double budget = default_cpu_budget;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool running = false;
+        bool awake = false;
+        std::thread worker;
+
+        // held while a tick runs, remove() takes it to wait one out.
+        std::mutex tick_mutex;
+
+        void work() {
+            std::unique_lock<std::mutex> lock(mutex);
+            bool active = false;
+
+            while (running) {
+                if (!active) {
+                    condition.wait(lock, [] { return awake || !running; });
+
+                    if (!running) {
+                        break;
+                    }
+                }
+
+                awake = false;
+
+                std::array<target*, max_targets> ticking = targets;
+                size_t count = target_count;
+                std::chrono::duration<double> period = interval;
+                double share = budget;
+
+                lock.unlock();
+
+                auto begin = std::chrono::steady_clock::now();
+                bool moving = false;
+
+                {
+                    std::lock_guard<std::mutex> tick_lock(tick_mutex);
+
+                    for (size_t i = 0; i < count; ++i) {
+                        moving = ticking[i]->animate(begin) || moving;
+                    }
+                }
+
+                std::chrono::duration<double> cost = std::chrono::steady_clock::now() - begin;
+
+                // too slow for the budget: tick less often rather than eat more CPU.
+                if (share > 0.0 && cost.count() > share * period.count()) {
+                    period = cost / share;
+                    MACROPAD_TRACE(info, animation_over_budget, static_cast<unsigned int>(cost.count() * 1000000.0), period.count());
+                }
+
+                lock.lock();
+                active = moving || awake;
+
+                if (active) {
+                    condition.wait_until(lock, begin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(period),
+                        [] { return !running; });
+                }
+            }
+        }
+    }
+
+    void start(unsigned int fps, double cpu_budget) {
+        configure(fps, cpu_budget);
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (running) {
+            return;
+        }
+
+        running = true;
+        awake = true;
+        worker = std::thread(work);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (!running) {
+                return;
+            }
+
+            running = false;
+        }
+
+        condition.notify_all();
+        worker.join();
+    }
+
+    void configure(unsigned int fps, double cpu_budget) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        interval = std::chrono::duration<double>(1.0 / std::max(fps, 1u));
+        budget = cpu_budget;
+    }
+
+    bool add(target* animated) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (target_count == max_targets) {
+            return false;
+        }
+
+        targets[target_count++] = animated;
+        return true;
+    }
+
+    void remove(target* animated) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto end = targets.begin() + target_count;
+            auto found = std::find(targets.begin(), end, animated);
+
+            if (found == end) {
+                return;
+            }
+
+            std::copy(found + 1, end, found);
+            --target_count;
+        }
+
+        // a tick may have copied the list before it changed.
+        std::lock_guard<std::mutex> tick_lock(tick_mutex);
+    }
+
+    void wake() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            awake = true;
+        }
+
+        condition.notify_one();
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+
+// one thread ticking every animated device at a fixed rate. a device composes its LED layers into the
+// framebuffer on the tick and wakes its writer, which sends whatever cells changed.
+// idle (nothing animating) it sleeps until woken. ticking costs at most cpu_budget of one core: if a tick takes
+// longer than that share of the interval, the interval stretches until it fits and frames get skipped.
+namespace macropad::animation {
+    class target {
+    public:
+        virtual ~target() {}
+
+        // animation thread. returns true if there's still something moving.
+        virtual bool animate(std::chrono::steady_clock::time_point now) = 0;
+    };
+
+    constexpr unsigned int default_fps = 30;
+    constexpr double default_cpu_budget = 0.02;
+
+    // registered targets, fixed so ticking never allocates.
+    constexpr size_t max_targets = 16;
+
+    void start(unsigned int fps = default_fps, double cpu_budget = default_cpu_budget);
+    void stop();
+
+    // takes effect from the next tick.
+    void configure(unsigned int fps, double cpu_budget);
+
+    // returns false if max_targets are registered already.
+    bool add(target* animated);
+    // waits out a tick in progress, so the target is safe to go away afterwards.
+    void remove(target* animated);
+
+    // something started moving, tick again even if everything was idle.
+    void wake();
+}
@@ -0,0 +1,274 @@
+#include "framework.h"
+#include "Button.h"
+#include "Config.h"
+#include "Executor.h"
+#include "Scheduler.h"
+#include <sstream>
+
+namespace macropad::buttons {
+    namespace {
+        // virtual keys are 0x01 - 0xFE. range first, the cast is only defined for numbers that fit an int.
+        const char* check_key_test(const button_source& source) {
+            if (!(source.number >= 0x01 && source.number <= 0xFE)) {
+                return "with a keycode outside 1 - 254";
+            }
+
+            if (source.number != static_cast<int>(source.number)) {
+                return "with a keycode that isn't a whole number";
+            }
+
+            return nullptr;
+        }
+
+        void compile_key_test(const button_source& source, config::button_record& out, config::compiled_config&) {
+            out.keycode = static_cast<int>(source.number);
+        }
+
+        Button make_key_test(const config::compiled_config&, const config::button_record& record) {
+            return ButtonSimpleKeycodeTest(record.keycode);
+        }
+
+        void compile_key_string(const button_source& source, config::button_record& out, config::compiled_config& result) {
+            // the one place text gets widened. the snapshot keeps it wide.
+            std::wstring text = string_to_wstring(source.text);
+
+            out.pacing = source.pacing;
+            out.text_offset = static_cast<unsigned int>(result.text.size());
+            out.text_length = static_cast<unsigned int>(text.size());
+            result.text.insert(result.text.end(), text.begin(), text.end());
+        }
+
+        Button make_key_string(const config::compiled_config& source, const config::button_record& record) {
+            return ButtonStringMacro(source.button_text(record), record.pacing);
+        }
+
+        // snapshots store the index, new types go at the end (or bump config::snapshot_version).
+        constexpr action_type types[] = {
+            { "key_test", data_kind::number, check_key_test, compile_key_test, make_key_test },
+            { "key_string", data_kind::string, nullptr, compile_key_string, make_key_string },
+        };
+
+        constexpr size_t type_total = sizeof(types) / sizeof(types[0]);
+    }
+
+    const char* data_kind_name(data_kind kind) {
+        switch (kind) {
+        case data_kind::none:
+            return "nothing";
+        case data_kind::number:
+            return "number";
+        case data_kind::string:
+            return "string";
+        default:
+            return "something else";
+        }
+    }
+
+    // a handful of types, looked up once per button at compile time. a scan is as quick as anything fancier.
+    int find_type(std::string_view name) {
+        for (size_t i = 0; i < type_total; ++i) {
+            if (name == types[i].name) {
+                return static_cast<int>(i);
+            }
+        }
+
+        return -1;
+    }
+
+    const action_type& get_type(unsigned char index) {
+        return types[index];
+    }
+
+    size_t type_count() {
+        return type_total;
+    }
+
+    Button make(const config::compiled_config& source, const config::button_record& record) {
+        if (record.type >= type_total) {
+            return Button();
+        }
+
+        return types[record.type].make(source, record);
+    }
+
+    void ButtonSimpleKeycodeTest::execute()
+    {
+        if (keycode == -1) {
+            return;
+        }
+
+        // send
+        key_event down = key_down(static_cast<unsigned short>(keycode));
+        injector().send(&down, 1);
+
+        // release later, timed by the scheduler but sent from the executor like every other key. if there's no
+        // timer to be had, let go now rather than leave the key stuck.
+        if (!scheduler::schedule(key_hold_ms, [](void* context, std::uintptr_t) {
+            executor::post_or_run(executor::job{ [](void* button, std::uintptr_t) {
+                static_cast<ButtonSimpleKeycodeTest*>(button)->release();
+            }, context });
+        }, this)) {
+            release();
+        }
+    }
+
+    void ButtonSimpleKeycodeTest::release()
+    {
+        key_event up = key_up(static_cast<unsigned short>(keycode));
+        injector().send(&up, 1);
+    }
+
+    void ButtonComplexMacro::execute()
+    {
+        this->func();
+    }
+
+    void ButtonStringMacro::compile(const std::wstring& string)
+    {
+        std::shared_ptr<typed_keys> keys = std::make_shared<typed_keys>();
+        std::vector<key_event>& events = keys->events;
+        std::vector<unsigned int>& steps = keys->steps;
+
+        events.reserve(string.size() * 2);
+        steps.reserve(string.size() + 1);
+
+        for (size_t i = 0; i < string.size(); ++i) {
+            steps.push_back(static_cast<unsigned int>(events.size()));
+
+            // the character as UTF-16. a 16 bit wchar_t (windows) already has surrogate pairs, a 32 bit one (linux)
+            // holds the whole code point.
+            char16_t units[2];
+            size_t count = 1;
+            unsigned long code_point = static_cast<unsigned long>(string[i]);
+
+            if (code_point > 0x10FFFF) {
+                units[0] = 0xFFFD;
+            }
+            else if (code_point > 0xFFFF) {
+                code_point -= 0x10000;
+                units[0] = static_cast<char16_t>(0xD800 + (code_point >> 10));
+                units[1] = static_cast<char16_t>(0xDC00 + (code_point & 0x3FF));
+                count = 2;
+            }
+            else if ((code_point & 0xFC00) == 0xD800 && i + 1 < string.size() && (string[i + 1] & 0xFC00) == 0xDC00) {
+                units[0] = static_cast<char16_t>(code_point);
+                units[1] = static_cast<char16_t>(string[++i]);
+                count = 2;
+            }
+            else {
+                units[0] = static_cast<char16_t>(code_point);
+            }
+
+            // both halves of a surrogate pair go down before either comes up, and always in the same step.
+            for (size_t j = 0; j < count; ++j) {
+                events.push_back(unicode_down(units[j]));
+            }
+
+            // release
+            for (size_t j = 0; j < count; ++j) {
+                events.push_back(unicode_up(units[j]));
+            }
+        }
+
+        steps.push_back(static_cast<unsigned int>(events.size()));
+        typed = std::move(keys);
+    }
+
+    void ButtonStringMacro::execute()
+    {
+        const std::vector<key_event>& events = typed->events;
+
+        if (events.empty()) {
+            return;
+        }
+
+        if (pacing > 0) {
+            type_step(0);
+            return;
+        }
+
+        // the whole string in one batch.
+        injector().send(events);
+    }
+
+    void ButtonStringMacro::type_step(size_t index)
+    {
+        const std::vector<key_event>& events = typed->events;
+        const std::vector<unsigned int>& steps = typed->steps;
+
+        injector().send(events.data() + steps[index], steps[index + 1] - steps[index]);
+
+        if (index + 2 >= steps.size()) {
+            return;
+        }
+
+        // paced mode for apps that drop fast input: each character schedules the next, so a run only ever holds one
+        // timer. the timer only posts the step, the typing happens on the executor so other macros can't cut in.
+        if (!scheduler::schedule(pacing, [](void* context, std::uintptr_t next) {
+            executor::post_or_run(executor::job{ [](void* button, std::uintptr_t step) {
+                static_cast<ButtonStringMacro*>(button)->type_step(step);
+            }, context, next });
+        }, this, index + 1)) {
+            // out of timers (schedule() traced it). the rest at once beats losing the end of the string.
+            injector().send(events.data() + steps[index + 1], events.size() - steps[index + 1]);
+        }
+    }
+
+    std::wstring ButtonStringMacro::to_wstring() const
+    {
+        std::wstring string;
+
+        for (const key_event& event : typed->events) {
+            if (event.up) {
+                continue;
+            }
+
+            // a 32 bit wchar_t takes the pair back as one character.
+            if (sizeof(wchar_t) > 2 && (event.code & 0xFC00) == 0xDC00 && !string.empty() && (string.back() & 0xFC00) == 0xD800) {
+                string.back() = static_cast<wchar_t>(0x10000 + ((static_cast<unsigned long>(string.back()) - 0xD800) << 10) + (event.code - 0xDC00));
+                continue;
+            }
+
+            string += static_cast<wchar_t>(event.code);
+        }
+
+        return L"ButtonStringMacro : str=\"" + string + L"\"";
+    }
+
+    std::wstring ButtonComplexMacro::to_wstring() const
+    {
+        std::wstringstream buffer;
+        buffer << std::hex << reinterpret_cast<void*>(this->func);
+
+        return L"ButtonComplexMacro : func_ptr=" + buffer.str();
+    }
+
+    std::wstring ButtonSimpleKeycodeTest::to_wstring() const
+    {
+        return L"ButtonSimpleKeycodeTest : keycode=" + std::to_wstring(this->keycode);
+    }
+
+    unsigned int Button::duration_ms() const
+    {
+        const ButtonStringMacro* string = std::get_if<ButtonStringMacro>(&action);
+        return string == nullptr ? 0 : string->duration_ms();
+    }
+
+    std::wstring Button::to_wstring() const
+    {
+        if (empty()) {
+            return L"Button : empty button";
+        }
+
+        std::wstring text = std::visit([](const auto& act) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(act)>, std::monostate>) {
+                return std::wstring();
+            }
+            else {
+                return act.to_wstring();
+            }
+        }, action);
+
+        return text + L" color=" + std::to_wstring(this->color);
+    }
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include "KeyInjector.h"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace config {
+    struct compiled_config;
+    struct button_record;
+}
+
+// what pad buttons do, the same on every device. the color is whatever the device's LEDs take (a velocity on the
+// S, palette or RGB on the MK2) and the device sets it.
+// a button is a plain value: its action is one of a fixed set, held in place, so buttons sit directly in a
+// device's page table and a press is a switch on the action rather than a virtual call through a heap object.
+// the registry at the bottom is how the config gets from a "type" name to a button. adding a type is one entry in
+// Button.cpp.
+namespace macropad::buttons {
+    // how long a key test button holds its key down.
+    constexpr unsigned int key_hold_ms = 100;
+
+    // the actions. scheduled steps point back into them, so they stay where they are once their table is published.
+    class ButtonSimpleKeycodeTest {
+        int keycode;
+    public:
+        ButtonSimpleKeycodeTest() : keycode(-1) {}
+        ButtonSimpleKeycodeTest(int keycode) : keycode(keycode) {}
+        void execute();
+        void release();
+        std::wstring to_wstring() const;
+    };
+
+    // a plain function, a captured std::function would be another allocation per button.
+    typedef void (*ComplexMacroFn)();
+
+    class ButtonComplexMacro {
+        ComplexMacroFn func;
+    public:
+        ButtonComplexMacro(ComplexMacroFn fun) : func(fun) {}
+        void execute();
+        std::wstring to_wstring() const;
+    };
+
+    class ButtonStringMacro {
+        // the string compiled once into key events, steps[i] is where character i starts, plus one end marker.
+        // the text itself isn't kept, to_wstring() reads it back off the key downs.
+        struct typed_keys {
+            std::vector<key_event> events;
+            std::vector<unsigned int> steps;
+        };
+
+        // never changed once compiled, so copies of the button (a reload keeping it) share the keys.
+        std::shared_ptr<const typed_keys> typed;
+        // ms between characters, 0 sends everything at once.
+        unsigned int pacing;
+        void compile(const std::wstring& string);
+    public:
+        ButtonStringMacro(const std::wstring& str, unsigned int pacing_ms = 0) : pacing(pacing_ms) { compile(str); }
+        void execute();
+        void type_step(size_t index);
+        // first character to last when paced, 0 when it all goes at once.
+        unsigned int duration_ms() const { return typed->steps.size() > 2 ? pacing * static_cast<unsigned int>(typed->steps.size() - 2) : 0; }
+        std::wstring to_wstring() const;
+    };
+
+    // monostate is an empty slot.
+    typedef std::variant<std::monostate, ButtonSimpleKeycodeTest, ButtonComplexMacro, ButtonStringMacro> button_action;
+
+    class Button {
+        button_action action;
+        unsigned int color;
+    public:
+        Button() : color(0) {}
+        template <typename Action>
+        Button(Action act) : action(std::move(act)), color(0) {}
+
+        inline bool empty() const { return std::holds_alternative<std::monostate>(action); }
+        inline void set_color(unsigned int col) { color = col; };
+        inline unsigned int get_color() const { return color; };
+
+        inline void execute()
+        {
+            std::visit([](auto& act) {
+                if constexpr (!std::is_same_v<std::decay_t<decltype(act)>, std::monostate>) {
+                    act.execute();
+                }
+            }, action);
+        }
+
+        // how long the action keeps going after execute(), 0 if it's done by then.
+        unsigned int duration_ms() const;
+
+        std::wstring to_wstring() const;
+    };
+
+    // what a button's "data" is.
+    enum class data_kind : unsigned char {
+        none,
+        number,
+        string,
+        other
+    };
+
+    const char* data_kind_name(data_kind kind);
+
+    // one button as the config compiler read it, before its type had a look at it.
+    struct button_source {
+        data_kind data;
+        double number;
+        std::string text;
+        unsigned int pacing;
+    };
+
+    struct action_type {
+        const char* name;
+        // what "data" has to be, anything else gets the button skipped.
+        data_kind data;
+        // the rest of the checks, once data is the right kind. nullptr if it's fine, otherwise why it isn't.
+        // may be null itself when there's nothing more to check.
+        const char* (*check)(const button_source& source);
+        // the type's part of the record, text goes into result.text.
+        void (*compile)(const button_source& source, config::button_record& out, config::compiled_config& result);
+        Button (*make)(const config::compiled_config& source, const config::button_record& record);
+    };
+
+    // button_record::type indexes the registry. -1 if there's no such type.
+    int find_type(std::string_view name);
+    const action_type& get_type(unsigned char index);
+    size_t type_count();
+
+    // an empty button if the record's type isn't one we have.
+    Button make(const config::compiled_config& source, const config::button_record& record);
+}
@@ -1,6 +1,12 @@
 #include "json.hpp"
 #include "framework.h"
+#include "Button.h"
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <locale>
 #include <string>
 
@@ -9,50 +15,689 @@ namespace config {
     std::filesystem::path file_path = std::filesystem::current_path() / L"config.json";
     // we can honestly do per-device config setting; too confusing. we already have enough buttons.
     // not everyone is taran.
-    nlohmann::json config_file;
+    std::shared_ptr<const compiled_config> compiled = std::make_shared<const compiled_config>();
+    // hash of the config.json compiled is from, 0 before the first load.
+    unsigned long long compiled_hash = 0;
+    std::filesystem::path snapshot_path = std::filesystem::path(file_path) += L".snapshot";
 };
 
+namespace {
+    // a whole file mapped read-only. data() is nullptr (and error set) if that didn't work.
+    // only for our own snapshot: while a view is open nobody can truncate the file, which would break an editor
+    // saving config.json in place.
+    class file_view {
+        HANDLE mapping = NULL;
+        const char* view = nullptr;
+        size_t length = 0;
+    public:
+        int error = 0;
+
+        explicit file_view(HANDLE file) {
+            LARGE_INTEGER file_size;
+
+            if (FALSE == GetFileSizeEx(file, &file_size)) {
+                error = GetLastError();
+                return;
+            }
+
+            // can't map an empty file.
+            if (file_size.QuadPart == 0) {
+                error = ERROR_HANDLE_EOF;
+                return;
+            }
+
+            mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+            if (mapping == NULL) {
+                error = GetLastError();
+                return;
+            }
+
+            view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+            if (view == nullptr) {
+                error = GetLastError();
+                return;
+            }
+
+            length = static_cast<size_t>(file_size.QuadPart);
+        }
+
+        ~file_view() {
+            if (view != nullptr)
+                UnmapViewOfFile(view);
+            if (mapping != NULL)
+                CloseHandle(mapping);
+        }
+
+        file_view(const file_view&) = delete;
+        file_view& operator=(const file_view&) = delete;
+
+        const char* data() const { return view; }
+        size_t size() const { return length; }
+    };
+
+    // config.json read into a buffer kept between loads (loads are serialized, see LoadConfig), so a reload
+    // doesn't allocate once the buffer is big enough. one ReadFile for anything but huge files. the handle is
+    // only read from, an editor can truncate or replace the file meanwhile; a short read just gets what's there
+    // and the watcher sees the rest of the save.
+    std::vector<char> source_buffer;
+
+    int read_source(HANDLE file) {
+        LARGE_INTEGER file_size;
+        LARGE_INTEGER start = {};
+
+        if (FALSE == GetFileSizeEx(file, &file_size) || FALSE == SetFilePointerEx(file, start, NULL, FILE_BEGIN))
+            return GetLastError();
+
+        source_buffer.resize(static_cast<size_t>(file_size.QuadPart));
+
+        size_t done = 0;
+
+        while (done < source_buffer.size()) {
+            DWORD chunk = static_cast<DWORD>(std::min<size_t>(source_buffer.size() - done, 0x40000000));
+            DWORD read = 0;
+
+            if (FALSE == ReadFile(file, source_buffer.data() + done, chunk, &read, NULL))
+                return GetLastError();
+
+            if (read == 0)
+                break;
+
+            done += read;
+        }
+
+        source_buffer.resize(done);
+        return 0;
+    }
+
+    // FNV-1a, 64 bit. plenty to notice config.json changed.
+    unsigned long long fnv1a(const char* data, size_t size) {
+        unsigned long long hash = 0xCBF29CE484222325ull;
+
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 0x100000001B3ull;
+        }
+
+        return hash;
+    }
+
+    // the snapshot is this, then the global settings and each array back to back. the record sizes are in here
+    // so a build with a different layout never reads an old file.
+    struct snapshot_header {
+        char magic[4];
+        unsigned int version;
+        unsigned long long source_hash;
+        unsigned int record_sizes[4];
+        unsigned int devices;
+        unsigned int buttons;
+        unsigned int text;
+        unsigned int names;
+    };
+
+    constexpr char snapshot_magic[4] = { 'M', 'P', 'C', 'S' };
+
+    snapshot_header make_header(unsigned long long source_hash, const config::compiled_config& compiled) {
+        snapshot_header header{};
+
+        std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+        header.version = config::snapshot_version;
+        header.source_hash = source_hash;
+        header.record_sizes[0] = sizeof(config::settings);
+        header.record_sizes[1] = sizeof(config::device_record);
+        header.record_sizes[2] = sizeof(config::button_record);
+        header.record_sizes[3] = sizeof(wchar_t);
+        header.devices = static_cast<unsigned int>(compiled.devices.size());
+        header.buttons = static_cast<unsigned int>(compiled.buttons.size());
+        header.text = static_cast<unsigned int>(compiled.text.size());
+        header.names = static_cast<unsigned int>(compiled.names.size());
+        return header;
+    }
+
+    template <typename T>
+    const char* read_array(const char* from, std::vector<T>& into, size_t count) {
+        into.resize(count);
+
+        if (count > 0)
+            std::memcpy(into.data(), from, count * sizeof(T));
+
+        return from + count * sizeof(T);
+    }
+
+    // [offset, offset + length) lies within size. 64 bit so a huge offset can't wrap around.
+    bool in_range(unsigned int offset, unsigned int length, size_t size) {
+        return static_cast<unsigned long long>(offset) + length <= size;
+    }
+
+    // every range in the records points into the arrays it was loaded with. the rest of the code indexes with
+    // them unchecked, so a snapshot that's the right size but corrupt has to stop here.
+    bool records_fit(const config::compiled_config& loaded) {
+        for (const config::device_record& device : loaded.devices) {
+            if (!in_range(device.name_offset, device.name_length, loaded.names.size())
+                || !in_range(device.first_button, device.button_count, loaded.buttons.size()))
+                return false;
+        }
+
+        for (const config::button_record& button : loaded.buttons) {
+            if (!in_range(button.text_offset, button.text_length, loaded.text.size())
+                || button.mode >= std::size(config::mode_names)
+                || button.type >= macropad::buttons::type_count())
+                return false;
+        }
+
+        return true;
+    }
+
+    // straight copies out of the mapping, no parsing. false if it's missing, stale, from another build or
+    // doesn't hold together (see records_fit), any of which means compile it again.
+    bool load_snapshot(unsigned long long source_hash, config::compiled_config& out) {
+        HANDLE file = CreateFileW(config::snapshot_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        bool loaded = false;
+
+        {
+            file_view snapshot(file);
+
+            if (snapshot.data() != nullptr && snapshot.size() >= sizeof(snapshot_header)) {
+                snapshot_header header;
+                std::memcpy(&header, snapshot.data(), sizeof(header));
+
+                snapshot_header expected = make_header(source_hash, config::compiled_config());
+                unsigned long long size = sizeof(snapshot_header) + sizeof(config::settings)
+                    + static_cast<unsigned long long>(header.devices) * sizeof(config::device_record)
+                    + static_cast<unsigned long long>(header.buttons) * sizeof(config::button_record)
+                    + static_cast<unsigned long long>(header.text) * sizeof(wchar_t)
+                    + header.names;
+
+                if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0
+                    && header.version == expected.version
+                    && header.source_hash == expected.source_hash
+                    && std::memcmp(header.record_sizes, expected.record_sizes, sizeof(header.record_sizes)) == 0
+                    && snapshot.size() == size) {
+                    const char* cursor = snapshot.data() + sizeof(snapshot_header);
+
+                    std::memcpy(&out.global, cursor, sizeof(config::settings));
+                    cursor += sizeof(config::settings);
+                    cursor = read_array(cursor, out.devices, header.devices);
+                    cursor = read_array(cursor, out.buttons, header.buttons);
+                    cursor = read_array(cursor, out.text, header.text);
+                    read_array(cursor, out.names, header.names);
+                    loaded = records_fit(out);
+                }
+            }
+        }
+
+        CloseHandle(file);
+
+        // compile() builds into the same record, don't leave it half filled.
+        if (!loaded)
+            out = config::compiled_config();
+
+        return loaded;
+    }
+
+    // written next to the real one and renamed over it, so a crash halfway never leaves a torn snapshot.
+    // failing to write it only costs the next launch a parse.
+    void save_snapshot(unsigned long long source_hash, const config::compiled_config& compiled) {
+        std::filesystem::path temporary = std::filesystem::path(config::snapshot_path) += L".tmp";
+
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+
+            if (!out)
+                return;
+
+            snapshot_header header = make_header(source_hash, compiled);
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(&compiled.global), sizeof(compiled.global));
+            out.write(reinterpret_cast<const char*>(compiled.devices.data()), compiled.devices.size() * sizeof(config::device_record));
+            out.write(reinterpret_cast<const char*>(compiled.buttons.data()), compiled.buttons.size() * sizeof(config::button_record));
+            out.write(reinterpret_cast<const char*>(compiled.text.data()), compiled.text.size() * sizeof(wchar_t));
+            out.write(compiled.names.data(), compiled.names.size());
+
+            if (!out)
+                return;
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporary, config::snapshot_path, error);
+    }
+
+    struct setting_name {
+        config::setting which;
+        const char* name;
+    };
+
+    constexpr setting_name global_settings[] = {
+        { config::setting::animation_fps, "animation_fps" },
+        { config::setting::animation_cpu_budget, "animation_cpu_budget" },
+    };
+
+    constexpr setting_name device_settings[] = {
+        { config::setting::double_buffered, "double_buffered" },
+        { config::setting::sysex_max_size, "sysex_max_size" },
+        { config::setting::output_rate, "output_rate" },
+        { config::setting::output_burst, "output_burst" },
+        { config::setting::calibrate_output, "calibrate_output" },
+    };
+
+    // bytes for sax_parse that leave behind how far the parser got, so whatever the handler reports can say where.
+    struct tracking_iterator {
+        typedef std::forward_iterator_tag iterator_category;
+        typedef char value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const char* pointer;
+        typedef const char& reference;
+
+        const char* at;
+        const char** seen;
+
+        reference operator*() const { return *at; }
+        tracking_iterator& operator++() { *seen = ++at; return *this; }
+        tracking_iterator operator++(int) { tracking_iterator old = *this; ++*this; return old; }
+        bool operator==(const tracking_iterator& other) const { return at == other.at; }
+        bool operator!=(const tracking_iterator& other) const { return at != other.at; }
+    };
+
+    // SAX handler that compiles straight into records, no DOM. config.json looks like
+    //   { settings..., "devices": { "name": { settings..., "session": { "0": [ { button }, ... ] } } } }
+    // anything we don't know is skipped wholesale, buttons that don't make sense are reported and left out.
+    class config_builder : public nlohmann::json::json_sax_t {
+        enum class level : unsigned char { root, devices, device, mode, page, button, position };
+
+        // a button's fields come in any order, they're checked once it's closed.
+        struct button_fields {
+            unsigned int position[2];
+            unsigned int position_count;
+            bool position_valid;
+            std::string type;
+            macropad::buttons::button_source source;
+        };
+
+        config::compiled_config& out;
+        const char* first;
+        const char* const* seen;
+
+        std::vector<level> stack;
+        // depth inside a value we don't use.
+        size_t skipping = 0;
+        // last key of the innermost object.
+        std::string last_key;
+
+        config::device_record device;
+        std::string device_name;
+        unsigned char mode;
+        std::string page_name;
+        unsigned char page;
+        size_t button_index;
+        button_fields button;
+
+        std::string where() const {
+            size_t line = 1;
+            const char* line_start = first;
+
+            for (const char* at = first; at < *seen; ++at) {
+                if (*at == '\n') {
+                    ++line;
+                    line_start = at + 1;
+                }
+            }
+
+            return std::to_string(line) + ":" + std::to_string(*seen - line_start + 1);
+        }
+
+        void skip_button(const std::string& reason) {
+            _DebugString("config.json:" + where() + ": " + device_name + "." + config::mode_names[mode] + "." + page_name
+                + "[" + std::to_string(button_index) + "] skipped, " + reason + "\n");
+        }
+
+        template <size_t N>
+        void set(config::settings& settings, const setting_name (&names)[N], double value) {
+            for (const setting_name& entry : names) {
+                if (last_key == entry.name) {
+                    size_t index = static_cast<size_t>(entry.which);
+                    settings.values[index] = value;
+                    settings.present |= 1u << index;
+                }
+            }
+        }
+
+        // a scalar. number is only meaningful for numbers and booleans.
+        bool scalar(bool is_number, bool is_unsigned, bool is_bool, double number, std::string* text) {
+            if (skipping > 0 || stack.empty())
+                return true;
+
+            switch (stack.back()) {
+            case level::root:
+                if (is_number || is_bool)
+                    set(out.global, global_settings, number);
+                break;
+            case level::device:
+                if (is_number || is_bool)
+                    set(device.device_settings, device_settings, number);
+                break;
+            case level::mode:
+                _DebugString("config.json:" + where() + ": " + device_name + "." + config::mode_names[mode] + " page \"" + last_key + "\" skipped\n");
+                break;
+            case level::page:
+                skip_button("not an object");
+                ++button_index;
+                break;
+            case level::button:
+                if (last_key == "type" && text != nullptr) {
+                    button.type = std::move(*text);
+                }
+                else if (last_key == "data") {
+                    button.source.data = is_number ? macropad::buttons::data_kind::number : text != nullptr ? macropad::buttons::data_kind::string : macropad::buttons::data_kind::other;
+                    button.source.number = number;
+
+                    if (text != nullptr)
+                        button.source.text = std::move(*text);
+                }
+                else if (last_key == "pacing" && is_unsigned) {
+                    button.source.pacing = static_cast<unsigned int>(number);
+                }
+                break;
+            case level::position:
+                if (button.position_count < 2) {
+                    button.position_valid = button.position_valid && is_unsigned && number <= 255;
+                    button.position[button.position_count] = static_cast<unsigned int>(number);
+                }
+                ++button.position_count;
+                break;
+            default:
+                break;
+            }
+
+            return true;
+        }
+
+        // opening an object or array. pushes what it is, or starts skipping it.
+        bool open(bool is_array) {
+            if (skipping > 0) {
+                ++skipping;
+                return true;
+            }
+
+            if (stack.empty()) {
+                // the top has to be an object, otherwise there's nothing for us in it.
+                if (is_array)
+                    ++skipping;
+                else
+                    stack.push_back(level::root);
+                return true;
+            }
+
+            switch (stack.back()) {
+            case level::root:
+                if (!is_array && last_key == "devices") {
+                    stack.push_back(level::devices);
+                    return true;
+                }
+                break;
+            case level::devices:
+                if (!is_array) {
+                    device = config::device_record{};
+                    device.first_button = static_cast<unsigned int>(out.buttons.size());
+                    device_name = last_key;
+                    stack.push_back(level::device);
+                    return true;
+                }
+                break;
+            case level::device:
+                if (!is_array) {
+                    for (unsigned char index = 0; index < std::size(config::mode_names); ++index) {
+                        if (last_key == config::mode_names[index]) {
+                            mode = index;
+                            stack.push_back(level::mode);
+                            return true;
+                        }
+                    }
+                }
+                break;
+            case level::mode: {
+                int index = -1;
+
+                try {
+                    index = std::stoi(last_key);
+                }
+                catch (std::exception&) {
+                }
+
+                if (!is_array || index < 0 || index > 255) {
+                    _DebugString("config.json:" + where() + ": " + device_name + "." + config::mode_names[mode] + " page \"" + last_key + "\" skipped\n");
+                    break;
+                }
+
+                page_name = last_key;
+                page = static_cast<unsigned char>(index);
+                button_index = 0;
+                stack.push_back(level::page);
+                return true;
+            }
+            case level::page:
+                if (!is_array) {
+                    button = button_fields{};
+                    button.position_valid = true;
+                    stack.push_back(level::button);
+                    return true;
+                }
+
+                skip_button("not an object");
+                ++button_index;
+                break;
+            case level::button:
+                if (is_array && last_key == "position") {
+                    stack.push_back(level::position);
+                    return true;
+                }
+
+                if (last_key == "data")
+                    button.source.data = macropad::buttons::data_kind::other;
+                break;
+            case level::position:
+                // only the first two count, and they have to be numbers.
+                if (button.position_count < 2)
+                    button.position_valid = false;
+                ++button.position_count;
+                break;
+            }
+
+            ++skipping;
+            return true;
+        }
+
+        bool close() {
+            if (skipping > 0) {
+                --skipping;
+                return true;
+            }
+
+            level closing = stack.back();
+            stack.pop_back();
+
+            if (closing == level::device) {
+                device.name_offset = static_cast<unsigned int>(out.names.size());
+                device.name_length = static_cast<unsigned int>(device_name.size());
+                device.button_count = static_cast<unsigned int>(out.buttons.size()) - device.first_button;
+                out.names.insert(out.names.end(), device_name.begin(), device_name.end());
+                out.devices.push_back(device);
+            }
+            else if (closing == level::button) {
+                finish_button();
+                ++button_index;
+            }
+
+            return true;
+        }
+
+        void finish_button() {
+            if (!button.position_valid || button.position_count < 2) {
+                skip_button("bad position");
+                return;
+            }
+
+            config::button_record record{};
+            record.mode = mode;
+            record.page = page;
+            record.x = static_cast<unsigned char>(button.position[0]);
+            record.y = static_cast<unsigned char>(button.position[1]);
+
+            int type = macropad::buttons::find_type(button.type);
+
+            if (type < 0) {
+                skip_button("unknown type \"" + button.type + "\"");
+                return;
+            }
+
+            const macropad::buttons::action_type& action = macropad::buttons::get_type(static_cast<unsigned char>(type));
+
+            if (action.data != macropad::buttons::data_kind::none && button.source.data != action.data) {
+                skip_button(std::string(action.name) + " without a " + macropad::buttons::data_kind_name(action.data));
+                return;
+            }
+
+            if (action.check != nullptr) {
+                if (const char* problem = action.check(button.source)) {
+                    skip_button(std::string(action.name) + " " + problem);
+                    return;
+                }
+            }
+
+            record.type = static_cast<unsigned char>(type);
+            action.compile(button.source, record, out);
+            out.buttons.push_back(record);
+        }
+
+    public:
+        config_builder(config::compiled_config& result, const char* source, const char* const* position)
+            : out(result), first(source), seen(position) {}
+
+        bool null() override { return scalar(false, false, false, 0.0, nullptr); }
+        bool boolean(bool value) override { return scalar(false, false, true, value ? 1.0 : 0.0, nullptr); }
+        bool number_integer(number_integer_t value) override { return scalar(true, false, false, static_cast<double>(value), nullptr); }
+        bool number_unsigned(number_unsigned_t value) override { return scalar(true, true, false, static_cast<double>(value), nullptr); }
+        bool number_float(number_float_t value, const string_t&) override { return scalar(true, false, false, value, nullptr); }
+        bool string(string_t& value) override { return scalar(false, false, false, 0.0, &value); }
+        bool binary(binary_t&) override { return scalar(false, false, false, 0.0, nullptr); }
+
+        bool start_object(std::size_t) override { return open(false); }
+        bool end_object() override { return close(); }
+        bool start_array(std::size_t) override { return open(true); }
+        bool end_array() override { return close(); }
+
+        bool key(string_t& value) override {
+            if (skipping == 0)
+                last_key = std::move(value);
+            return true;
+        }
+
+        bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e) override {
+            _DebugString("config.json:" + where() + ": " + e.what() + "\n");
+            return false;
+        }
+    };
+
+    void publish(config::compiled_config&& loaded, unsigned long long hash) {
+        std::atomic_store(&config::compiled, std::shared_ptr<const config::compiled_config>(std::make_shared<config::compiled_config>(std::move(loaded))));
+        config::compiled_hash = hash;
+    }
+}
+
 int config::openFileHandle() {
-    file_handle = CreateFileW(file_path.c_str(), GENERIC_READ | GENERIC_WRITE, NULL, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    // shared, so an editor saving while we read doesn't fail: the handle is only ever read from (never mapped, see
+    // read_source). if we catch a save halfway the watcher sees the end of it and we load again.
+    file_handle = CreateFileW(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
     if (file_handle == INVALID_HANDLE_VALUE)
         return GetLastError();
     return 0;
 };
 
+// reads config.json and hashes it. if the snapshot was compiled from the same bytes that's all the loading there is.
+// otherwise the UTF-8 is parsed straight out of the read buffer (no wide string), compiled and snapshotted.
 int config::loadFile() {
-    std::wstring str = L"";
-    const int buffer_size = 1024;
-    LARGE_INTEGER file_size;
+    int error = read_source(file_handle);
 
-    GetFileSizeEx(file_handle, &file_size);
+    if (error != 0)
+        return error;
 
-    // bytes left over
-    long long bytes_left = file_size.QuadPart;
-    
-    char buffer[buffer_size];
-    DWORD dwBtytesRead;
-    OVERLAPPED ol = { 0 };
+    // empty, keep what we had.
+    if (source_buffer.empty())
+        return ERROR_HANDLE_EOF;
 
-    for (; bytes_left >= 0; bytes_left -= buffer_size) {
-        if (FALSE == ReadFile(file_handle, buffer, buffer_size, &dwBtytesRead, NULL))
-        {
-            return GetLastError();
-        }
+    unsigned long long hash = fnv1a(source_buffer.data(), source_buffer.size());
 
-        // used to find the buffer size you need for the wide string.
-        int buffer_2_size = MultiByteToWideChar(CP_UTF8, 0, buffer, dwBtytesRead, nullptr, 0);
-        // + 1 for null termination.
-        wchar_t *buffer_2 = new wchar_t[static_cast<size_t>(buffer_2_size) + 1];
-        // convert.
-        MultiByteToWideChar(CP_UTF8, 0, buffer, dwBtytesRead, buffer_2, buffer_2_size);
-        // add null termination
-        buffer_2[buffer_2_size] = 0x0;
-        // append.
-        str += std::wstring(buffer_2);
+    // saved without changes, or the watcher saw one save twice.
+    if (hash == compiled_hash)
+        return 0;
 
-        delete[] buffer_2;
+    compiled_config loaded;
+
+    if (load_snapshot(hash, loaded)) {
+        publish(std::move(loaded), hash);
+        return 0;
     }
 
-    config_file = nlohmann::json::parse(str);
+    // not JSON (or caught halfway through a save), keep what we had.
+    if (!compile(source_buffer.data(), source_buffer.size(), loaded))
+        return ERROR_INVALID_DATA;
+
+    save_snapshot(hash, loaded);
+    publish(std::move(loaded), hash);
     return 0;
-};
\ No newline at end of file
+};
+
+std::shared_ptr<const config::compiled_config> config::current() {
+    return std::atomic_load(&compiled);
+}
+
+const config::device_record* config::compiled_config::find_device(const std::string& name) const {
+    for (const device_record& device : devices) {
+        if (device.name_length == name.size() && std::memcmp(names.data() + device.name_offset, name.data(), name.size()) == 0)
+            return &device;
+    }
+
+    return nullptr;
+}
+
+config::button_range config::compiled_config::device_buttons(const device_record& device) const {
+    const button_record* first = buttons.data() + device.first_button;
+    return button_range{ first, first + device.button_count };
+}
+
+std::wstring config::compiled_config::button_text(const button_record& button) const {
+    return std::wstring(text.data() + button.text_offset, button.text_length);
+}
+
+std::vector<const config::button_record*> config::button_cells(const compiled_config& source, const device_record& device, size_t mode_count, size_t page_count) {
+    std::vector<const button_record*> cells(mode_count * page_count * 64, nullptr);
+
+    for (const button_record& button : source.device_buttons(device)) {
+        if (button.mode >= mode_count || button.page >= page_count || button.x >= 8 || button.y >= 8)
+            continue;
+
+        cells[(button.mode * page_count + button.page) * 64 + button.x * 8 + button.y] = &button;
+    }
+
+    return cells;
+}
+
+bool config::same_button(const compiled_config& a, const button_record& x, const compiled_config& b, const button_record& y) {
+    if (x.type != y.type || x.keycode != y.keycode || x.pacing != y.pacing || x.text_length != y.text_length)
+        return false;
+
+    return x.text_length == 0 || std::wmemcmp(a.text.data() + x.text_offset, b.text.data() + y.text_offset, x.text_length) == 0;
+}
+
+bool config::compile(const char* data, size_t size, compiled_config& result) {
+    const char* seen = data;
+    config_builder builder(result, data, &seen);
+
+    // a UTF-8 BOM is skipped by the parser.
+    return nlohmann::json::sax_parse(tracking_iterator{ data, &seen }, tracking_iterator{ data + size, &seen }, &builder);
+}
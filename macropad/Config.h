@@ -1,13 +1,113 @@
 #pragma once
+#include <array>
 #include <filesystem>
-#include "json.hpp"
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace config {
     extern HANDLE file_handle;
     extern std::filesystem::path file_path;
-    extern nlohmann::json config_file;
 
     int openFileHandle();
+    // one at a time. leaves current() alone if the file didn't change since the last load.
     int loadFile();
 
-};
\ No newline at end of file
+    // config.json boiled down to flat records, which is what the devices build from. loadFile fills it, from the
+    // snapshot next to config.json when that was compiled from the same bytes, otherwise by parsing and compiling
+    // the JSON (and writing a new snapshot).
+    enum class setting : unsigned char {
+        // top level
+        animation_fps,
+        animation_cpu_budget,
+        // per device
+        double_buffered,
+        sysex_max_size,
+        output_rate,
+        output_burst,
+        calibrate_output,
+        count
+    };
+
+    struct settings {
+        std::array<double, static_cast<size_t>(setting::count)> values;
+        // bit per setting the config actually has.
+        unsigned int present;
+
+        template <typename T>
+        T value(setting which, T fallback) const {
+            size_t index = static_cast<size_t>(which);
+            return present & (1u << index) ? static_cast<T>(values[index]) : fallback;
+        }
+    };
+
+    // mode sections of a device, button_record::mode indexes this.
+    constexpr const char* mode_names[] = { "session", "user_1", "user_2", "mixer", "fallback" };
+
+    struct button_record {
+        unsigned char mode;
+        unsigned char page;
+        unsigned char x;
+        unsigned char y;
+        // index into the button registry, see Button.h.
+        unsigned char type;
+        int keycode;
+        unsigned int pacing;
+        // key_string text, a range of compiled_config::text
+        unsigned int text_offset;
+        unsigned int text_length;
+    };
+
+    struct device_record {
+        // a range of compiled_config::names
+        unsigned int name_offset;
+        unsigned int name_length;
+        settings device_settings;
+        // a range of compiled_config::buttons
+        unsigned int first_button;
+        unsigned int button_count;
+    };
+
+    struct button_range {
+        const button_record* first;
+        const button_record* last;
+
+        const button_record* begin() const { return first; }
+        const button_record* end() const { return last; }
+    };
+
+    struct compiled_config {
+        settings global{};
+        std::vector<device_record> devices;
+        std::vector<button_record> buttons;
+        // key_string text, already wide
+        std::vector<wchar_t> text;
+        std::vector<char> names;
+
+        const device_record* find_device(const std::string& name) const;
+        button_range device_buttons(const device_record& device) const;
+        std::wstring button_text(const button_record& button) const;
+    };
+
+    // a device's buttons by where they go, laid out like a page_table: the first mode_count modes, page_count pages
+    // of 8x8 each ((mode * page_count + page) * 64 + x * 8 + y). records that don't fit are left out, of two for
+    // the same spot the later one wins.
+    std::vector<const button_record*> button_cells(const compiled_config& source, const device_record& device, size_t mode_count, size_t page_count);
+
+    // x from a and y from b would make the same button (a and b can be different loads).
+    bool same_button(const compiled_config& a, const button_record& x, const compiled_config& b, const button_record& y);
+
+    // what the last load produced, swapped whole. hold on to the pointer while building from it, a reload can
+    // publish a new one at any time.
+    std::shared_ptr<const compiled_config> current();
+
+    // bump whenever a record changes shape or compile() builds different ones, old snapshots then just get
+    // recompiled.
+    constexpr unsigned int snapshot_version = 4;
+    extern std::filesystem::path snapshot_path;
+
+    // streams the JSON straight into records, nothing of the document is kept. false if it isn't JSON (reported
+    // with line and column). buttons that don't make sense are skipped and reported the same way, the rest still
+    // compiles.
+    bool compile(const char* data, size_t size, compiled_config& result);
+};
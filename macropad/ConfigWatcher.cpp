@@ -0,0 +1,230 @@
+#ifdef _WIN32
+#include "framework.h"
+#endif
+#include "ConfigWatcher.h"
+#include <thread>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace config::watcher {
+    namespace {
+        std::filesystem::path watched;
+        std::function<void()> callback;
+        std::thread worker;
+        bool running = false;
+
+#ifdef _WIN32
+        HANDLE directory = INVALID_HANDLE_VALUE;
+        HANDLE changes_event = NULL;
+        // set by stop().
+        HANDLE stop_event = NULL;
+
+        // true if a batch of change records names our file. an empty batch means the buffer overflowed, which
+        // could have been anything.
+        bool mentions_file(const char* records, DWORD size) {
+            if (size == 0)
+                return true;
+
+            const std::wstring name = watched.filename().wstring();
+
+            for (;;) {
+                const FILE_NOTIFY_INFORMATION* record = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(records);
+                size_t length = record->FileNameLength / sizeof(wchar_t);
+
+                // file names on windows don't care about case.
+                if (length == name.size() && _wcsnicmp(record->FileName, name.c_str(), length) == 0)
+                    return true;
+
+                if (record->NextEntryOffset == 0)
+                    return false;
+
+                records += record->NextEntryOffset;
+            }
+        }
+
+        void work() {
+            // DWORD aligned, the records are read straight out of it.
+            alignas(DWORD) char buffer[4096];
+            OVERLAPPED overlapped{};
+            overlapped.hEvent = changes_event;
+
+            const HANDLE waits[] = { changes_event, stop_event };
+
+            for (;;) {
+                ResetEvent(changes_event);
+
+                if (FALSE == ReadDirectoryChangesW(directory, buffer, sizeof(buffer), FALSE,
+                        FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE, NULL, &overlapped, NULL)) {
+                    _DebugString("config watcher: ReadDirectoryChangesW failed, " + std::to_string(GetLastError()) + "\n");
+                    return;
+                }
+
+                DWORD size = 0;
+
+                if (WaitForMultipleObjects(2, waits, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                    // stopping. the read has to be done with the buffer before it goes away.
+                    CancelIo(directory);
+                    GetOverlappedResult(directory, &overlapped, &size, TRUE);
+                    return;
+                }
+
+                if (FALSE == GetOverlappedResult(directory, &overlapped, &size, FALSE) || !mentions_file(buffer, size))
+                    continue;
+
+                // more writes in the meantime pile up in the directory handle and come back as one more round.
+                if (WaitForSingleObject(stop_event, settle_ms) == WAIT_OBJECT_0)
+                    return;
+
+                callback();
+            }
+        }
+#endif
+
+#ifdef __linux__
+        int notify_fd = -1;
+        // stop() writes to stop_pipe[1].
+        int stop_pipe[2] = { -1, -1 };
+
+        bool mentions_file(const char* records, ssize_t size) {
+            const std::string name = watched.filename().string();
+
+            for (ssize_t offset = 0; offset < size;) {
+                const inotify_event* record = reinterpret_cast<const inotify_event*>(records + offset);
+
+                if (record->mask & IN_Q_OVERFLOW)
+                    return true;
+
+                if (record->len > 0 && name == record->name)
+                    return true;
+
+                offset += sizeof(inotify_event) + record->len;
+            }
+
+            return false;
+        }
+
+        // drains whatever inotify has queued. returns true if any of it was about our file.
+        bool read_changes() {
+            alignas(inotify_event) char buffer[4096];
+            bool ours = false;
+
+            for (;;) {
+                ssize_t size = read(notify_fd, buffer, sizeof(buffer));
+
+                if (size <= 0)
+                    return ours;
+
+                ours = mentions_file(buffer, size) || ours;
+            }
+        }
+
+        void work() {
+            pollfd waits[] = { { notify_fd, POLLIN, 0 }, { stop_pipe[0], POLLIN, 0 } };
+
+            for (;;) {
+                if (poll(waits, 2, -1) < 0) {
+                    if (errno == EINTR)
+                        continue;
+
+                    return;
+                }
+
+                if (waits[1].revents != 0)
+                    return;
+
+                if (!read_changes())
+                    continue;
+
+                // wait for the writes to stop, then take whatever they were along with them.
+                while (poll(&waits[1], 1, settle_ms) == 0) {
+                    if (!read_changes())
+                        break;
+                }
+
+                if (waits[1].revents != 0)
+                    return;
+
+                callback();
+            }
+        }
+
+        void close_all() {
+            for (int* fd : { &notify_fd, &stop_pipe[0], &stop_pipe[1] }) {
+                if (*fd >= 0) {
+                    close(*fd);
+                    *fd = -1;
+                }
+            }
+        }
+#endif
+    }
+
+    bool start(const std::filesystem::path& file, std::function<void()> changed) {
+        if (running)
+            return true;
+
+        watched = file;
+        callback = changed;
+        std::filesystem::path folder = file.has_parent_path() ? file.parent_path() : std::filesystem::current_path();
+
+#ifdef _WIN32
+        directory = CreateFileW(folder.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+            NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+
+        if (directory == INVALID_HANDLE_VALUE) {
+            _DebugString(L"config watcher: can't open " + folder.wstring() + L", " + std::to_wstring(GetLastError()) + L"\n");
+            return false;
+        }
+
+        changes_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+        stop_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+#endif
+
+#ifdef __linux__
+        notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+        if (notify_fd < 0 || pipe2(stop_pipe, O_CLOEXEC) != 0
+            || inotify_add_watch(notify_fd, folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+            close_all();
+            return false;
+        }
+#endif
+
+        running = true;
+        worker = std::thread(work);
+        return true;
+    }
+
+    void stop() {
+        if (!running)
+            return;
+
+        running = false;
+
+#ifdef _WIN32
+        SetEvent(stop_event);
+        worker.join();
+
+        CloseHandle(directory);
+        CloseHandle(changes_event);
+        CloseHandle(stop_event);
+        directory = INVALID_HANDLE_VALUE;
+        changes_event = stop_event = NULL;
+#endif
+
+#ifdef __linux__
+        char stop_byte = 0;
+        (void)write(stop_pipe[1], &stop_byte, 1);
+        worker.join();
+        close_all();
+#endif
+
+        callback = nullptr;
+    }
+}
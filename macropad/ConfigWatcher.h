@@ -0,0 +1,15 @@
+#pragma once
+#include <filesystem>
+#include <functional>
+
+// calls changed() when the config file is saved. the directory is watched rather than the file, editors that
+// save by writing a temp file and renaming it over the old one count too. changed() runs on the watcher thread,
+// settle_ms after the last write, so one save is one reload.
+// ReadDirectoryChangesW on windows, inotify on linux.
+namespace config::watcher {
+    constexpr unsigned int settle_ms = 100;
+
+    // false if the directory can't be watched, reloading by hand still works then.
+    bool start(const std::filesystem::path& file, std::function<void()> changed);
+    void stop();
+}
@@ -0,0 +1,91 @@
+#ifdef _WIN32
+#include "framework.h"
+#endif
+#include "Executor.h"
+#include "InFlight.h"
+#include "Trace.h"
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace macropad::executor {
+    namespace {
+        // fixed ring guarded by a mutex. the lock is only ever held for a copy, never while a job runs.
+        std::array<job, queue_size> jobs;
+        size_t head = 0;
+        size_t count = 0;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool running = false;
+        std::thread worker;
+
+        void work() {
+            for (;;) {
+                job next;
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    condition.wait(lock, [] { return count > 0 || !running; });
+
+                    // finish what was already posted before shutting down.
+                    if (count == 0) {
+                        return;
+                    }
+
+                    next = jobs[head];
+                    head = (head + 1) % queue_size;
+                    --count;
+                }
+
+                next.run(next.context, next.arg);
+                in_flight::end();
+            }
+        }
+    }
+
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (running) {
+            return;
+        }
+
+        running = true;
+        worker = std::thread(work);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (!running) {
+                return;
+            }
+
+            running = false;
+        }
+
+        condition.notify_all();
+        worker.join();
+    }
+
+    bool post(const job& item) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (!running || count == queue_size) {
+                MACROPAD_TRACE(error, action_dropped, static_cast<unsigned int>(count), 0.0);
+                return false;
+            }
+
+            jobs[(head + count) % queue_size] = item;
+            ++count;
+            in_flight::begin();
+        }
+
+        condition.notify_one();
+        return true;
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// runs button actions off the MIDI input threads.
+// device loops only post; the (single) worker calls execute(), so a slow macro never stalls input or LED feedback.
+// one worker on purpose: injected keystrokes from different macros must not interleave.
+namespace macropad::executor {
+    // function pointer + context so posting never allocates. same shape as a scheduler callback.
+    struct job {
+        void (*run)(void* context, std::uintptr_t arg);
+        void* context;
+        std::uintptr_t arg = 0;
+    };
+
+    // pending jobs past this are dropped (and traced).
+    constexpr size_t queue_size = 256;
+
+    void start();
+    void stop();
+
+    // returns false if the queue is full or the executor isn't running. a posted job is in_flight until it ran.
+    bool post(const job& item);
+
+    // post target->execute().
+    template <typename T>
+    bool post_execute(T* target) {
+        return post(job{ [](void* context, std::uintptr_t) { static_cast<T*>(context)->execute(); }, target });
+    }
+
+    // for timed steps that inject keys: post it, or if that fails run it here. a key left down or a string cut
+    // short is worse than keys from two macros mixing.
+    inline void post_or_run(const job& item) {
+        if (!post(item)) {
+            item.run(item.context, item.arg);
+        }
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// button work that has started and not finished: executor jobs posted and not run yet, scheduler timers filed
+// and not fired yet, as one count. a timer posting its step, or a step scheduling the next one, counts the new
+// piece before it lets go of its own, so the total never drops to zero halfway through an action. the executor
+// and the scheduler keep it, page tables are only freed while it's zero (see PageTable.h).
+namespace macropad::in_flight {
+    inline std::atomic<size_t> count{ 0 };
+
+    inline void begin() { count.fetch_add(1); }
+    inline void end() { count.fetch_sub(1); }
+
+    inline bool none() { return count.load() == 0; }
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <array>
+#include "RtMidi.h"
+
+// decoded pad input, shared by every device model.
+namespace midi_device {
+	// released is always pressed + 1, see decode_input.
+	enum class input_kind : unsigned char {
+		invalid = 0,
+		grid_pressed,
+		grid_released,
+		// right hand column (scene launch on the S, arrows on the MK2). we use it to change pages.
+		page_pressed,
+		page_released,
+		// top row, sent as controllers (104 - 111) on every model so far.
+		control_pressed,
+		control_released
+	};
+
+	// x is the row, y the column. slot is where a grid key's button is on a page (see page_table::slot).
+	// key is the raw note/controller number so LED feedback doesn't have to recalculate it.
+	struct input_event {
+		input_kind kind;
+		unsigned char x;
+		unsigned char y;
+		unsigned char slot;
+		unsigned char velocity;
+		unsigned char key;
+		double timestamp;
+	};
+
+	// one entry per note (0x00 - 0x7F) followed by one per controller (0x80 - 0xFF).
+	struct input_key {
+		input_kind pressed;
+		unsigned char x;
+		unsigned char y;
+		unsigned char slot;
+	};
+
+	typedef std::array<input_key, 256> input_key_table;
+
+	constexpr unsigned char input_table_controller = 0x80;
+
+	// top row controllers are the same on the S and the MK2.
+	constexpr unsigned char control_first = 104;
+	constexpr unsigned char control_count = 8;
+
+	// everything is a table load. the only real branch is throwing out messages that aren't note/cc.
+	constexpr input_event decode_input(const input_key_table& table, const RtMidiEvent& event)
+	{
+		const unsigned char status = event.bytes[0] & 0xF0;
+		const bool note_on = status == 0x90;
+		const bool note_off = status == 0x80;
+		const bool controller = status == 0xB0;
+
+		if (event.size != 3 || !(note_on || note_off || controller)) {
+			return input_event{ input_kind::invalid, 0, 0, 0, 0, event.bytes[1], event.timeStamp };
+		}
+
+		const unsigned char key = event.bytes[1] & 0x7F;
+		const unsigned char velocity = event.bytes[2];
+		const input_key& entry = table[(controller ? input_table_controller : 0) | key];
+
+		// note on with velocity 0 is how the pads say "released".
+		const unsigned char released = (note_off || velocity == 0) && entry.pressed != input_kind::invalid;
+
+		return input_event{
+			static_cast<input_kind>(static_cast<unsigned char>(entry.pressed) + released),
+			entry.x,
+			entry.y,
+			entry.slot,
+			velocity,
+			key,
+			event.timeStamp
+		};
+	}
+
+	// shared by the per-model tables.
+	constexpr void add_control_keys(input_key_table& table)
+	{
+		for (unsigned char i = 0; i < control_count; ++i) {
+			table[input_table_controller | (control_first + i)] = input_key{ input_kind::control_pressed, 0, i, 0 };
+		}
+	}
+
+	// one 3 byte message through decode_input, for the compile time checks here and in the device headers.
+	constexpr input_event decode_message(const input_key_table& table, unsigned char status, unsigned char key, unsigned char velocity)
+	{
+		return decode_input(table, RtMidiEvent{ { status, key, velocity }, 3, 0.0 });
+	}
+
+	constexpr input_key_table make_control_keys()
+	{
+		input_key_table table{};
+		add_control_keys(table);
+		return table;
+	}
+
+	// the ends of the top row, and one past each.
+	static_assert(decode_message(make_control_keys(), 0xB0, 104, 0x7F).kind == input_kind::control_pressed
+		&& decode_message(make_control_keys(), 0xB0, 104, 0x7F).y == 0, "cc 104 is the first control");
+	static_assert(decode_message(make_control_keys(), 0xB0, 111, 0x00).kind == input_kind::control_released
+		&& decode_message(make_control_keys(), 0xB0, 111, 0x00).y == 7, "cc 111 is the last control");
+	static_assert(decode_message(make_control_keys(), 0xB0, 103, 0x7F).kind == input_kind::invalid
+		&& decode_message(make_control_keys(), 0xB0, 112, 0x7F).kind == input_kind::invalid, "only 104 - 111 are controls");
+	// notes don't land on the controller half of the table.
+	static_assert(decode_message(make_control_keys(), 0x90, 104, 0x7F).kind == input_kind::invalid, "note 104 isn't a control");
+}
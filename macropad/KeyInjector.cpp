@@ -0,0 +1,434 @@
+#ifdef _WIN32
+#include "framework.h"
+#endif
+#include "KeyInjector.h"
+#include "Trace.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+namespace macropad {
+    namespace {
+        std::atomic<KeyInjector*> current{ nullptr };
+
+#ifdef _WIN32
+        // SendInput takes INPUTs from the stack this many at a time.
+        constexpr size_t send_chunk = 256;
+#endif
+
+#ifdef __linux__
+        // windows virtual key -> evdev key, 0 where there's no sensible match.
+        constexpr std::array<unsigned short, 256> make_vk_keys() {
+            std::array<unsigned short, 256> keys{};
+
+            constexpr unsigned short letters[] = {
+                KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H, KEY_I, KEY_J, KEY_K, KEY_L, KEY_M,
+                KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R, KEY_S, KEY_T, KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z
+            };
+            constexpr unsigned short digits[] = { KEY_0, KEY_1, KEY_2, KEY_3, KEY_4, KEY_5, KEY_6, KEY_7, KEY_8, KEY_9 };
+            constexpr unsigned short keypad[] = { KEY_KP0, KEY_KP1, KEY_KP2, KEY_KP3, KEY_KP4, KEY_KP5, KEY_KP6, KEY_KP7, KEY_KP8, KEY_KP9 };
+            constexpr unsigned short functions[] = {
+                KEY_F1, KEY_F2, KEY_F3, KEY_F4, KEY_F5, KEY_F6, KEY_F7, KEY_F8, KEY_F9, KEY_F10, KEY_F11, KEY_F12,
+                KEY_F13, KEY_F14, KEY_F15, KEY_F16, KEY_F17, KEY_F18, KEY_F19, KEY_F20, KEY_F21, KEY_F22, KEY_F23, KEY_F24
+            };
+
+            for (int i = 0; i < 26; ++i) {
+                keys[0x41 + i] = letters[i];
+            }
+
+            for (int i = 0; i < 10; ++i) {
+                keys[0x30 + i] = digits[i];
+                keys[0x60 + i] = keypad[i];
+            }
+
+            for (int i = 0; i < 24; ++i) {
+                keys[0x70 + i] = functions[i];
+            }
+
+            keys[0x08] = KEY_BACKSPACE;
+            keys[0x09] = KEY_TAB;
+            keys[0x0D] = KEY_ENTER;
+            keys[0x10] = KEY_LEFTSHIFT;
+            keys[0x11] = KEY_LEFTCTRL;
+            keys[0x12] = KEY_LEFTALT;
+            keys[0x13] = KEY_PAUSE;
+            keys[0x14] = KEY_CAPSLOCK;
+            keys[0x1B] = KEY_ESC;
+            keys[0x20] = KEY_SPACE;
+            keys[0x21] = KEY_PAGEUP;
+            keys[0x22] = KEY_PAGEDOWN;
+            keys[0x23] = KEY_END;
+            keys[0x24] = KEY_HOME;
+            keys[0x25] = KEY_LEFT;
+            keys[0x26] = KEY_UP;
+            keys[0x27] = KEY_RIGHT;
+            keys[0x28] = KEY_DOWN;
+            keys[0x2C] = KEY_SYSRQ;
+            keys[0x2D] = KEY_INSERT;
+            keys[0x2E] = KEY_DELETE;
+            keys[0x5B] = KEY_LEFTMETA;
+            keys[0x5C] = KEY_RIGHTMETA;
+            keys[0x5D] = KEY_COMPOSE;
+            keys[0x6A] = KEY_KPASTERISK;
+            keys[0x6B] = KEY_KPPLUS;
+            keys[0x6D] = KEY_KPMINUS;
+            keys[0x6E] = KEY_KPDOT;
+            keys[0x6F] = KEY_KPSLASH;
+            keys[0x90] = KEY_NUMLOCK;
+            keys[0x91] = KEY_SCROLLLOCK;
+            keys[0xA0] = KEY_LEFTSHIFT;
+            keys[0xA1] = KEY_RIGHTSHIFT;
+            keys[0xA2] = KEY_LEFTCTRL;
+            keys[0xA3] = KEY_RIGHTCTRL;
+            keys[0xA4] = KEY_LEFTALT;
+            keys[0xA5] = KEY_RIGHTALT;
+            keys[0xAD] = KEY_MUTE;
+            keys[0xAE] = KEY_VOLUMEDOWN;
+            keys[0xAF] = KEY_VOLUMEUP;
+            keys[0xB0] = KEY_NEXTSONG;
+            keys[0xB1] = KEY_PREVIOUSSONG;
+            keys[0xB2] = KEY_STOPCD;
+            keys[0xB3] = KEY_PLAYPAUSE;
+            keys[0xBA] = KEY_SEMICOLON;
+            keys[0xBB] = KEY_EQUAL;
+            keys[0xBC] = KEY_COMMA;
+            keys[0xBD] = KEY_MINUS;
+            keys[0xBE] = KEY_DOT;
+            keys[0xBF] = KEY_SLASH;
+            keys[0xC0] = KEY_GRAVE;
+            keys[0xDB] = KEY_LEFTBRACE;
+            keys[0xDC] = KEY_BACKSLASH;
+            keys[0xDD] = KEY_RIGHTBRACE;
+            keys[0xDE] = KEY_APOSTROPHE;
+
+            return keys;
+        }
+
+        constexpr std::array<unsigned short, 256> vk_keys = make_vk_keys();
+
+        // printable ASCII on a US layout. false if it needs the unicode sequence instead.
+        bool ascii_key(unsigned int c, unsigned short& key, bool& shift) {
+            shift = false;
+
+            if (c >= 'a' && c <= 'z') {
+                key = vk_keys[c - 'a' + 0x41];
+                return true;
+            }
+
+            if (c >= 'A' && c <= 'Z') {
+                key = vk_keys[c];
+                shift = true;
+                return true;
+            }
+
+            if (c >= '0' && c <= '9') {
+                key = vk_keys[c];
+                return true;
+            }
+
+            switch (c) {
+            case '\n': key = KEY_ENTER; return true;
+            case '\t': key = KEY_TAB; return true;
+            case ' ': key = KEY_SPACE; return true;
+            case '-': key = KEY_MINUS; return true;
+            case '=': key = KEY_EQUAL; return true;
+            case '[': key = KEY_LEFTBRACE; return true;
+            case ']': key = KEY_RIGHTBRACE; return true;
+            case '\\': key = KEY_BACKSLASH; return true;
+            case ';': key = KEY_SEMICOLON; return true;
+            case '\'': key = KEY_APOSTROPHE; return true;
+            case '`': key = KEY_GRAVE; return true;
+            case ',': key = KEY_COMMA; return true;
+            case '.': key = KEY_DOT; return true;
+            case '/': key = KEY_SLASH; return true;
+            }
+
+            shift = true;
+
+            switch (c) {
+            case '!': key = KEY_1; return true;
+            case '@': key = KEY_2; return true;
+            case '#': key = KEY_3; return true;
+            case '$': key = KEY_4; return true;
+            case '%': key = KEY_5; return true;
+            case '^': key = KEY_6; return true;
+            case '&': key = KEY_7; return true;
+            case '*': key = KEY_8; return true;
+            case '(': key = KEY_9; return true;
+            case ')': key = KEY_0; return true;
+            case '_': key = KEY_MINUS; return true;
+            case '+': key = KEY_EQUAL; return true;
+            case '{': key = KEY_LEFTBRACE; return true;
+            case '}': key = KEY_RIGHTBRACE; return true;
+            case '|': key = KEY_BACKSLASH; return true;
+            case ':': key = KEY_SEMICOLON; return true;
+            case '"': key = KEY_APOSTROPHE; return true;
+            case '~': key = KEY_GRAVE; return true;
+            case '<': key = KEY_COMMA; return true;
+            case '>': key = KEY_DOT; return true;
+            case '?': key = KEY_SLASH; return true;
+            }
+
+            return false;
+        }
+#endif
+
+        KeyInjector& platform_injector() {
+#ifdef _WIN32
+            static SendInputInjector injector;
+#elif defined(__linux__)
+            static UinputInjector injector;
+#else
+            static RecordingInjector injector;
+#endif
+            return injector;
+        }
+    }
+
+#ifdef _WIN32
+    size_t SendInputInjector::send(const key_event* events, size_t count) {
+        std::array<INPUT, send_chunk> inputs;
+        size_t sent = 0;
+
+        while (sent < count) {
+            size_t chunk = std::min(count - sent, send_chunk);
+
+            for (size_t i = 0; i < chunk; ++i) {
+                const key_event& event = events[sent + i];
+                INPUT& input = inputs[i];
+
+                input.type = INPUT_KEYBOARD;
+                input.ki.time = 0;
+                input.ki.dwExtraInfo = NULL;
+
+                if (event.kind == key_kind::unicode) {
+                    input.ki.wVk = NULL;
+                    input.ki.wScan = event.code;
+                    input.ki.dwFlags = KEYEVENTF_UNICODE;
+                }
+                else {
+                    input.ki.wVk = event.code;
+                    input.ki.wScan = NULL;
+                    input.ki.dwFlags = 0;
+                }
+
+                if (event.up) {
+                    input.ki.dwFlags |= KEYEVENTF_KEYUP;
+                }
+            }
+
+            // SendInput can stop short (blocked by UIPI, desktop switch). carry on from wherever it stopped until
+            // it refuses outright.
+            size_t offset = 0;
+
+            while (offset < chunk) {
+                UINT done = SendInput(static_cast<UINT>(chunk - offset), inputs.data() + offset, sizeof(INPUT));
+
+                if (done == 0) {
+                    MACROPAD_TRACE(error, inject_short, static_cast<unsigned int>(count - sent - offset), 0.0);
+                    return sent + offset;
+                }
+
+                offset += done;
+            }
+
+            sent += chunk;
+        }
+
+        return sent;
+    }
+#endif
+
+#ifdef __linux__
+    UinputInjector::UinputInjector() : fd(-1), high_surrogate(0) {
+        fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+
+        if (fd < 0) {
+            MACROPAD_TRACE(error, inject_short, static_cast<unsigned int>(errno), 0.0);
+            return;
+        }
+
+        ioctl(fd, UI_SET_EVBIT, EV_KEY);
+
+        for (int key = KEY_ESC; key <= KEY_MAX && key < 0x100; ++key) {
+            ioctl(fd, UI_SET_KEYBIT, key);
+        }
+
+        uinput_setup setup;
+        std::memset(&setup, 0, sizeof(setup));
+        setup.id.bustype = BUS_VIRTUAL;
+        std::strncpy(setup.name, "macropad virtual keyboard", UINPUT_MAX_NAME_SIZE - 1);
+
+        if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+            MACROPAD_TRACE(error, inject_short, static_cast<unsigned int>(errno), 0.0);
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    UinputInjector::~UinputInjector() {
+        if (fd >= 0) {
+            ioctl(fd, UI_DEV_DESTROY);
+            close(fd);
+        }
+    }
+
+    void UinputInjector::emit(unsigned short type, unsigned short code, int value) {
+        ::input_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.type = type;
+        event.code = code;
+        event.value = value;
+        buffer.push_back(event);
+    }
+
+    void UinputInjector::tap(unsigned short key, bool shift) {
+        if (shift) {
+            emit(EV_KEY, KEY_LEFTSHIFT, 1);
+        }
+
+        emit(EV_KEY, key, 1);
+        emit(EV_SYN, SYN_REPORT, 0);
+        emit(EV_KEY, key, 0);
+
+        if (shift) {
+            emit(EV_KEY, KEY_LEFTSHIFT, 0);
+        }
+
+        emit(EV_SYN, SYN_REPORT, 0);
+    }
+
+    void UinputInjector::type_code_point(unsigned int code_point) {
+        unsigned short key;
+        bool shift;
+
+        if (code_point < 0x80 && ascii_key(code_point, key, shift)) {
+            tap(key, shift);
+            return;
+        }
+
+        // ctrl+shift+u, the hex digits, space to commit.
+        emit(EV_KEY, KEY_LEFTCTRL, 1);
+        emit(EV_KEY, KEY_LEFTSHIFT, 1);
+        emit(EV_SYN, SYN_REPORT, 0);
+        tap(KEY_U, false);
+        emit(EV_KEY, KEY_LEFTSHIFT, 0);
+        emit(EV_KEY, KEY_LEFTCTRL, 0);
+        emit(EV_SYN, SYN_REPORT, 0);
+
+        char hex[9];
+        std::snprintf(hex, sizeof(hex), "%x", code_point);
+
+        for (const char* digit = hex; *digit != '\0'; ++digit) {
+            ascii_key(static_cast<unsigned char>(*digit), key, shift);
+            tap(key, false);
+        }
+
+        tap(KEY_SPACE, false);
+    }
+
+    size_t UinputInjector::send(const key_event* events, size_t count) {
+        if (fd < 0) {
+            return 0;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        buffer.clear();
+
+        for (size_t i = 0; i < count; ++i) {
+            const key_event& event = events[i];
+
+            if (event.kind == key_kind::virtual_key) {
+                unsigned short key = vk_keys[event.code & 0xFF];
+
+                if (key != 0) {
+                    emit(EV_KEY, key, event.up ? 0 : 1);
+                    emit(EV_SYN, SYN_REPORT, 0);
+                }
+
+                continue;
+            }
+
+            // a whole character goes out on key down, ups have nothing left to do.
+            if (event.up) {
+                continue;
+            }
+
+            if ((event.code & 0xFC00) == 0xD800) {
+                high_surrogate = static_cast<wchar_t>(event.code);
+                continue;
+            }
+
+            unsigned int code_point = event.code;
+
+            if ((event.code & 0xFC00) == 0xDC00 && high_surrogate != 0) {
+                code_point = 0x10000 + ((static_cast<unsigned int>(high_surrogate) - 0xD800) << 10) + (event.code - 0xDC00);
+            }
+
+            high_surrogate = 0;
+            type_code_point(code_point);
+        }
+
+        size_t size = buffer.size() * sizeof(::input_event);
+
+        if (size > 0 && write(fd, buffer.data(), size) != static_cast<ssize_t>(size)) {
+            MACROPAD_TRACE(error, inject_short, static_cast<unsigned int>(count), 0.0);
+            return 0;
+        }
+
+        return count;
+    }
+#endif
+
+    size_t RecordingInjector::send(const key_event* events, size_t count) {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (size_t i = 0; i < count; ++i) {
+            recorded.push_back(entry{ events[i], now });
+        }
+
+        ++batch_count;
+        return count;
+    }
+
+    std::vector<RecordingInjector::entry> RecordingInjector::events() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return recorded;
+    }
+
+    size_t RecordingInjector::size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return recorded.size();
+    }
+
+    size_t RecordingInjector::batches() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return batch_count;
+    }
+
+    void RecordingInjector::clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        recorded.clear();
+        batch_count = 0;
+    }
+
+    KeyInjector& injector() {
+        KeyInjector* replacement = current.load(std::memory_order_acquire);
+        return replacement != nullptr ? *replacement : platform_injector();
+    }
+
+    void set_injector(KeyInjector* replacement) {
+        current.store(replacement, std::memory_order_release);
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#ifdef __linux__
+#include <linux/input.h>
+#endif
+
+// where button actions send their keystrokes. buttons build key_events, the injector turns them into whatever
+// the platform wants. swap it out (set_injector) to record instead of type.
+namespace macropad {
+    enum class key_kind : unsigned char {
+        // code is a windows virtual key
+        virtual_key,
+        // code is a UTF-16 code unit
+        unicode
+    };
+
+    struct key_event {
+        key_kind kind;
+        bool up;
+        unsigned short code;
+    };
+
+    constexpr key_event key_down(unsigned short vk) { return key_event{ key_kind::virtual_key, false, vk }; }
+    constexpr key_event key_up(unsigned short vk) { return key_event{ key_kind::virtual_key, true, vk }; }
+    // UTF-16 units, not wchar_t: on linux a wchar_t is a whole code point and has to be split first.
+    constexpr key_event unicode_down(char16_t unit) { return key_event{ key_kind::unicode, false, static_cast<unsigned short>(unit) }; }
+    constexpr key_event unicode_up(char16_t unit) { return key_event{ key_kind::unicode, true, static_cast<unsigned short>(unit) }; }
+
+    class KeyInjector {
+    public:
+        virtual ~KeyInjector() {}
+
+        // inject events in order. returns how many made it.
+        virtual size_t send(const key_event* events, size_t count) = 0;
+
+        size_t send(const std::vector<key_event>& events) { return send(events.data(), events.size()); }
+    };
+
+#ifdef _WIN32
+    // SendInput, a chunk of events per call.
+    class SendInputInjector : public KeyInjector {
+    public:
+        size_t send(const key_event* events, size_t count) override;
+    };
+#endif
+
+#ifdef __linux__
+    // virtual keyboard on /dev/uinput (needs write access to it, usually the input group or a udev rule).
+    // virtual keys map to the matching evdev keys. unicode goes through the US layout when it can, anything
+    // else is typed as ctrl+shift+u <hex> space, which GTK/IBus understand.
+    class UinputInjector : public KeyInjector {
+        int fd;
+        wchar_t high_surrogate;
+        std::mutex mutex;
+        std::vector<::input_event> buffer;
+
+        void emit(unsigned short type, unsigned short code, int value);
+        void tap(unsigned short key, bool shift);
+        void type_code_point(unsigned int code_point);
+    public:
+        UinputInjector();
+        ~UinputInjector();
+        bool is_open() const { return fd >= 0; }
+        size_t send(const key_event* events, size_t count) override;
+    };
+#endif
+
+    // keeps everything it's given, for tests and benchmarks.
+    class RecordingInjector : public KeyInjector {
+    public:
+        struct entry {
+            key_event event;
+            std::chrono::steady_clock::time_point time;
+        };
+
+        size_t send(const key_event* events, size_t count) override;
+
+        std::vector<entry> events() const;
+        size_t size() const;
+        // number of send() calls so far
+        size_t batches() const;
+        void clear();
+    private:
+        mutable std::mutex mutex;
+        std::vector<entry> recorded;
+        size_t batch_count = 0;
+    };
+
+    // the injector buttons use. the platform one unless something else was set.
+    KeyInjector& injector();
+
+    // nullptr goes back to the platform injector. the old one has to stay alive until in-flight actions finish.
+    void set_injector(KeyInjector* replacement);
+}
@@ -6,6 +6,10 @@
 #include "Launchpad.h"
 #include "macropad.h"
 #include "Config.h"
+#include "Trace.h"
+#include "Executor.h"
+#include "Scheduler.h"
+#include "Animation.h"
 
 
 // r
@@ -64,10 +68,23 @@ void midi_device::launchpad::Launchpad::Init() {
         }
     }
 
-    this->setup_pages_test();
-    this->fullLedUpdate();
+    writer.start(out);
+
+    // start from a known blank state, from here on only changes get sent.
+    this->reset();
+
+    macropad::animation::add(this);
+
+    // in devices before the first load: a reload from here on comes to us, and pages_mutex puts it before or
+    // after this one, so whichever goes last has the newest config.
+    {
+        std::lock_guard<std::mutex> lock(midi_device::devices_mutex);
+        midi_device::devices.push_back(this);
+    }
 
-    midi_device::devices.push_back(this);
+    // config pages if there's a config for us, the test page otherwise.
+    this->load_pages(true);
+    this->fullLedUpdate();
 }
 
 void midi_device::launchpad::Launchpad::reset()
@@ -76,7 +93,15 @@ void midi_device::launchpad::Launchpad::reset()
     if (!out->isPortOpen())
         return;
 
-    out->sendMessage(launchpad::commands::reset, sizeof(unsigned char) * 3);
+    std::lock_guard<std::mutex> lock(led_mutex);
+    this->sendMessage(launchpad::commands::reset);
+
+    // reset blanks both buffers and shows buffer 0.
+    leds.assume(launchpad::commands::vel_off_off);
+    displayed_buffer = 0;
+    frame_drawn = false;
+    this->selectBuffers();
+    writer.wake(false);
 }
 
 void midi_device::launchpad::Launchpad::low_brightness_test()
@@ -85,7 +110,12 @@ void midi_device::launchpad::Launchpad::low_brightness_test()
     if (!out->isPortOpen())
         return;
 
-    out->sendMessage(launchpad::commands::brightness_test_low, sizeof(unsigned char) * 3);
+    std::lock_guard<std::mutex> lock(led_mutex);
+    this->sendMessage(launchpad::commands::brightness_test_low);
+
+    // every LED is lit now, whatever we thought was showing. no present, or the test would be drawn over at once.
+    leds.invalidate();
+    writer.wake(false);
 }
 
 void midi_device::launchpad::Launchpad::medium_brightness_test()
@@ -94,7 +124,10 @@ void midi_device::launchpad::Launchpad::medium_brightness_test()
     if (!out->isPortOpen())
         return;
 
-    out->sendMessage(launchpad::commands::brightness_test_med, sizeof(unsigned char) * 3);
+    std::lock_guard<std::mutex> lock(led_mutex);
+    this->sendMessage(launchpad::commands::brightness_test_med);
+    leds.invalidate();
+    writer.wake(false);
 }
 
 void midi_device::launchpad::Launchpad::full_brightness_test()
@@ -103,7 +136,10 @@ void midi_device::launchpad::Launchpad::full_brightness_test()
     if (!out->isPortOpen())
         return;
 
-    out->sendMessage(launchpad::commands::brightness_test_full, sizeof(unsigned char) * 3);
+    std::lock_guard<std::mutex> lock(led_mutex);
+    this->sendMessage(launchpad::commands::brightness_test_full);
+    leds.invalidate();
+    writer.wake(false);
 }
 
 void midi_device::launchpad::Launchpad::RunDevice()
@@ -113,195 +149,341 @@ void midi_device::launchpad::Launchpad::RunDevice()
     main_device->Loop();
 }
 
-midi_device::launchpad::message_type midi_device::launchpad::input::message_type() {
-    midi_device::launchpad::message_type type = static_cast<midi_device::launchpad::message_type>(message.at(0) + message.at(2));
-    
-    // this shouldn't happen...
-    if (type > message_type::automap_live_pressed || type < message_type::grid_depressed) {
-        return message_type::invalid;
-    }
-    
-    if (message.at(1) % 0x10 == 0x08) {
-        if (type == message_type::grid_depressed) {
-            return message_type::grid_page_change_depressed;
-        }
-        else if (type == message_type::grid_pressed) {
-            return message_type::grid_page_change_pressed;
-        }
-    }
-
-    return static_cast<midi_device::launchpad::message_type>(message.at(0) + message.at(2));
-}
-
-unsigned char midi_device::launchpad::input::keycode() {
-    return message.at(1);
-}
-
-
 /// <summary>
 /// launchpad input loop...
 /// </summary>
 void midi_device::launchpad::Launchpad::Loop() {
     std::vector<unsigned char> message;
-    int nBytes, i;
-    double stamp;
-    launchpad::config::ButtonBase* button;
+    std::array<RtMidiEvent, input_batch_size> events;
+    unsigned int count, n;
+    bool needs_full_update;
+    launchpad::config::Button* button;
+    std::shared_ptr<const launchpad_pages> table;
 
     while (should_loop && execute_all)
     {
-        stamp = in->getMessage(&message);
-        nBytes = message.size();
-
-        // no message. skip
-        if (nBytes == 0) {
+        // sleep until the driver queues something instead of spinning on getMessage.
+        if (!in->waitForMessage(input_wait_timeout_ms)) {
+            // quiet, a good time to free pages a reload left behind.
+            pages.reclaim();
             continue;
         }
 
-        for (i = 0; i < nBytes; i++)
-            _DebugString("Byte " + std::to_string(i) + " = " + std::to_string((int)message[i]) + ", ");
-        if (nBytes > 0)
-            _DebugString("stamp = " + std::to_string(stamp) + "\n");
+        count = in->getMessages(events.data(), static_cast<unsigned int>(events.size()));
 
-        if (nBytes != 3) {
+        // nothing short at the front of the queue, so it's sysex. we don't use it, drop it.
+        if (count == 0) {
+            in->getMessage(&message);
+            MACROPAD_TRACE(info, sysex_ignored, static_cast<unsigned int>(message.size()), 0.0);
             continue;
         }
 
-        midi_device::launchpad::input input = midi_device::launchpad::input(message);
+        MACROPAD_TRACE(verbose, input_wake, count, in->getWakeLatency());
 
-        switch (input.message_type()) {
-        case message_type::grid_pressed: {
-            this->sendMessage(launchpad::commands::led_on(input.keycode(), launchpad::commands::vel_red_full));
-            break;
-        }
-        case message_type::grid_depressed: {
-            button = get_button(input.keycode());
+        // page and mode changes only need one repaint per batch, no matter how many came in.
+        needs_full_update = false;
 
-            if (button == nullptr) {
-                this->sendMessage(launchpad::commands::led_off(input.keycode(), launchpad::commands::vel_off_off));
+        // one table for the whole batch. a reload publishing meanwhile shows up in the next one.
+        table = pages.load();
+
+        std::lock_guard<std::mutex> lock(led_mutex);
+
+        for (n = 0; n < count; n++) {
+            const RtMidiEvent& event = events[n];
+
+            MACROPAD_TRACE(verbose, midi_in, macropad::trace::pack(event.bytes[0], event.bytes[1], event.bytes[2]), event.timeStamp);
+
+            const input_event input = decode_input(input_keys, event);
+
+            switch (input.kind) {
+            case input_kind::grid_pressed: {
+                layers.press(led_grid_cell(input.x, input.y), launchpad::commands::vel_red_full);
+                break;
             }
-            else {
-                button->execute();
-                this->sendMessage(launchpad::commands::led_on(input.keycode(), button->get_color()));
+            case input_kind::grid_released: {
+                button = get_button(*table, input.slot);
+
+                if (button == nullptr) {
+                    layers.release(led_grid_cell(input.x, input.y), 0);
+                }
+                else {
+                    // never run the action here, the input thread would be stuck until it's done.
+                    macropad::executor::post_execute(button);
+                    layers.release(led_grid_cell(input.x, input.y), release_fade_ms);
+
+                    // a paced string fills the top row up while it types.
+                    if (unsigned int typing_ms = button->duration_ms()) {
+                        layers.timed_progress(led_control_cell(0), led_columns, launchpad::commands::vel_green_full, typing_ms);
+                    }
+                }
+                break;
             }
-            break;
-        }
-        case message_type::grid_page_change_pressed: {
-            // change page.
-            page = message[1] / 0x10;
+            case input_kind::page_pressed: {
+                // change page.
+                page = input.x;
 
-            // update all buttons
-            this->fullLedUpdate();
-            break;
-        }
-        case message_type::automap_live_pressed: {
-            if (message[1] >= 108) {
-                mode = static_cast<launchpad::mode>(message[1]);
+                // update all buttons
+                needs_full_update = true;
+                break;
             }
-            this->fullLedUpdate();
-            break;
-        }
-        case message_type::automap_live_depressed: {
-            break;
+            case input_kind::control_pressed: {
+                if (input.key >= 108) {
+                    mode = static_cast<launchpad::mode>(input.key);
+                }
+                needs_full_update = true;
+                break;
+            }
+            default: {
+                break;
+            }
+            }
+
+            button = nullptr;
         }
+
+        if (needs_full_update) {
+            this->render();
+            frame_pending = true;
         }
 
-        button = nullptr;
-        message.clear();
+        this->compose();
+
+        // whatever changed in this batch goes out together, from the writer thread.
+        writer.wake();
+
+        // buttons posted above are in the executor's queue by now, the old table can go once they're done.
+        table.reset();
+        pages.reclaim();
+    }
+
+    if (in->getOverflowCount() > 0) {
+        MACROPAD_TRACE(error, input_overflow, static_cast<unsigned int>(in->getOverflowCount()), 0.0);
     }
 
     // end of loop. reset
+    macropad::animation::remove(this);
     this->reset();
+    writer.stop();
 }
 
-midi_device::launchpad::config::ButtonBase* midi_device::launchpad::Launchpad::get_button(unsigned char key)
+midi_device::launchpad::config::Button* midi_device::launchpad::Launchpad::get_button(const launchpad_pages& table, unsigned char slot)
 {
-    if (page >= pages.size()) {
-        return nullptr;
-    }
+    return table.get(mode_index(mode), page, slot);
+}
+
+// custom calculated messages go here. queued for the writer, call with led_mutex held.
+void midi_device::launchpad::Launchpad::sendMessage(const std::array<unsigned char, 3>& message)
+{
+    writer.post(message);
+}
 
-    if (pages.at(page) == nullptr) {
-        return nullptr;
+// draws the current page into the base layer. nothing shows until compose().
+void midi_device::launchpad::Launchpad::render()
+{
+    layers.fill_base(launchpad::commands::vel_off_off);
+
+    // set our page indicator
+    if (page < led_rows) {
+        layers.set_base(led_grid_cell(page, 8), launchpad::commands::vel_yellow_full);
     }
 
-    int x, y;
-    commands::calculate_xy_fom_keycode(key, x, y);
+    // set our "mode" indicator
+    layers.set_base(led_control_cell(static_cast<size_t>(mode) - 104), launchpad::commands::vel_yellow_full);
+
+    std::shared_ptr<const launchpad_pages> table = pages.load();
+    config::Button* buttons = table->page_buttons(mode_index(mode), page);
 
-    return pages.at(page)->at(x).at(y);
+    if (buttons == nullptr) {
+        return;
+    }
+
+    for (size_t slot = 0; slot < launchpad_pages::page_slots; ++slot) {
+        if (!buttons[slot].empty()) {
+            layers.set_base(led_grid_cell(slot / 8, slot % 8), static_cast<unsigned char>(buttons[slot].get_color()));
+        }
+    }
 }
 
-// custom calculated messages go here
-void midi_device::launchpad::Launchpad::sendMessage(unsigned char* message)
+// layers into the framebuffer, led_mutex held. the writer still has to be woken.
+void midi_device::launchpad::Launchpad::compose()
 {
-    if (!out->isPortOpen()) {  
-        goto cleanup;
+    if (layers.compose(leds)) {
+        macropad::animation::wake();
     }
-    
-    try {
-        out->sendMessage(message, sizeof(unsigned char) * 3);
-    }
-    catch (RtMidiError& error) {
-        error.printMessage();
-        _DebugString(error.getMessage());
+}
+
+// animation thread.
+bool midi_device::launchpad::Launchpad::animate(std::chrono::steady_clock::time_point now)
+{
+    std::lock_guard<std::mutex> lock(led_mutex);
+
+    if (!layers.animating()) {
+        return false;
     }
-    
-    cleanup: 
-        delete[] message;
+
+    bool moving = layers.compose(leds, now);
+    writer.wake();
+    return moving;
 }
 
-// this will literally update EVERYTHING. do NOT call this functionm unless you ABSOLUTELY NEED TO!
-void midi_device::launchpad::Launchpad::fullLedUpdate()
+// writer thread, led_mutex held. every LED message is 3 bytes, so the budget is just a message count.
+// returns true if some of it has to wait for the next round.
+bool midi_device::launchpad::Launchpad::flushLeds(size_t budget)
 {
-    // don't do anything.
+    // don't do anything. the shadow stays as it was, so it's all sent once the port is there.
     if (!out->isPortOpen())
-        return;
+        return false;
 
-    // reset everything first.
-    out->sendMessage(launchpad::commands::reset, sizeof(unsigned char) * 3);
+    size_t limit = budget / sizeof(launchpad::commands::midi_message);
 
-    // set our page indicator
-    this->sendMessage(launchpad::commands::led_on(0x10 * page + 0x08, launchpad::commands::vel_yellow_full));
+    // press feedback first, straight into both buffers so it shows even halfway through a frame.
+    limit -= leds.present_urgent([this](size_t cell, unsigned char color) {
+        this->sendLed(cell, color);
+    }, limit);
 
-    // set our "mode" indicator
-    this->sendMessage(new unsigned char[3]{ 0xB0, (unsigned char)mode, launchpad::commands::vel_yellow_full });
+    if (frame_pending && double_buffered) {
+        return !this->presentFrame(limit);
+    }
 
-    // update every LEDs.
-    if ((size_t)page < pages.size()) {
+    frame_pending = false;
+    this->presentLeds(limit);
+    return leds.changed() > 0;
+}
 
-        // row
-        for (size_t row = 0; row < pages.at(page)->size(); ++row) {
-            // column
-            for (size_t col = 0; col < pages.at(page)->at(row).size(); ++col) {
-                if (pages.at(page) == nullptr) {
-                    continue;
-                }
+// sends the cells that differ from what the pad shows, as many as fit.
+void midi_device::launchpad::Launchpad::presentLeds(size_t limit)
+{
+    leds.present([this](size_t cell, unsigned char color) {
+        this->sendLed(cell, color);
+    }, limit);
+}
 
-                config::ButtonBase* button = pages.at(page)->at(row).at(col);
+void midi_device::launchpad::Launchpad::sendLed(size_t cell, unsigned char velocity)
+{
+    if (led_is_control(cell)) {
+        this->sendMessage(launchpad::commands::controller_change(static_cast<unsigned char>(0x68 + led_cell_control(cell)), velocity));
+    }
+    else {
+        this->sendMessage(launchpad::commands::led_on(commands::calculate_grid(
+            static_cast<unsigned char>(led_cell_row(cell)), static_cast<unsigned char>(led_cell_column(cell))), velocity));
+    }
+}
 
-                if (button == nullptr) {
-                    continue;
-                }
+namespace {
+    // framebuffer cell for the nth LED of a rapid update.
+    constexpr size_t rapid_update_cell(size_t index)
+    {
+        using namespace midi_device;
 
-                this->sendMessage(launchpad::commands::led_on(commands::calculate_grid(row, col), button->get_color()));
-            }
-        
+        if (index < 64) {
+            return led_grid_cell(index / 8, index % 8);
         }
+
+        if (index < 72) {
+            return led_grid_cell(index - 64, 8);
+        }
+
+        return led_control_cell(index - 72);
+    }
+}
+
+// a whole new frame. drawn into the hidden buffer, over as many rounds as the budget needs, then flipped in.
+// returns true once it's shown (or there was nothing to draw).
+bool midi_device::launchpad::Launchpad::presentFrame(size_t limit)
+{
+    size_t changed = leds.changed();
+    size_t sent = 0;
+
+    // the hidden buffer matches the shadow (the last flip copied it), so the usual diff is enough. past half
+    // the pad, rapid update (two LEDs a message) is cheaper than one message per LED, but it has to go out in
+    // one piece, and the flip after it counts too.
+    if (changed > led_cells / 2 && limit > led_cells / 2) {
+        // the last thing sent was never a rapid update message, so the cursor is at the start.
+        for (size_t i = 0; i < led_cells; i += 2) {
+            this->sendMessage(launchpad::commands::rapid_update(
+                leds.get(rapid_update_cell(i)) & ~launchpad::commands::velocity_flags,
+                leds.get(rapid_update_cell(i + 1)) & ~launchpad::commands::velocity_flags));
+        }
+
+        leds.commit();
+        frame_drawn = true;
+        sent = led_cells / 2;
+    }
+    else if (changed > 0) {
+        sent = leds.present([this](size_t cell, unsigned char color) {
+            this->sendLed(cell, color & ~launchpad::commands::velocity_flags);
+        }, limit);
+        frame_drawn = sent > 0 || frame_drawn;
+    }
+
+    if (leds.changed() > 0) {
+        return false;
     }
+
+    if (!frame_drawn) {
+        frame_pending = false;
+        return true;
+    }
+
+    // the flip is a message as well. no room left for it, it goes first next round.
+    if (sent >= limit) {
+        return false;
+    }
+
+    frame_pending = false;
+
+    // show it, and copy it over so both buffers match the shadow again.
+    unsigned char hidden = 1 - displayed_buffer;
+    this->sendMessage(launchpad::commands::controller_change(0x00, launchpad::commands::buffer_select(hidden, displayed_buffer, true)));
+    displayed_buffer = hidden;
+    frame_drawn = false;
+    return true;
+}
+
+// updates go to the hidden buffer when double buffered, to the displayed one otherwise.
+void midi_device::launchpad::Launchpad::selectBuffers()
+{
+    if (!out->isPortOpen())
+        return;
+
+    unsigned char update = double_buffered ? 1 - displayed_buffer : displayed_buffer;
+    this->sendMessage(launchpad::commands::controller_change(0x00, launchpad::commands::buffer_select(displayed_buffer, update, true)));
+}
+
+// redraws the whole page, but only changed cells hit the wire.
+void midi_device::launchpad::Launchpad::fullLedUpdate()
+{
+    std::lock_guard<std::mutex> lock(led_mutex);
+
+    this->render();
+    this->compose();
+    frame_pending = true;
+    writer.wake();
 }
 
 void midi_device::launchpad::Launchpad::setup_pages_test()
 {
-    launchpad_grid* page = new launchpad_grid{ nullptr };
+    std::lock_guard<std::mutex> pages_lock(pages_mutex);
+    this->publish_test_pages();
+}
+
+// pages_mutex held.
+void midi_device::launchpad::Launchpad::publish_test_pages()
+{
+    std::shared_ptr<launchpad_pages> table = std::make_shared<launchpad_pages>(mode_count, 1);
 
-    config::ButtonBase* button = new config::ButtonSimpleKeycodeTest(0x41);
+    // session mode, page 0 comes first, so the slots are the indices.
 
-    button->set_color(launchpad::commands::calculate_velocity(commands::led_brightness::high, commands::led_brightness::high));
+    config::Button button = config::ButtonSimpleKeycodeTest(0x41);
 
-    page->at(7)[7] = button;
+    button.set_color(launchpad::commands::calculate_velocity(commands::led_brightness::high, commands::led_brightness::high));
 
-    button = new config::ButtonComplexMacro([]() { _DebugString("lol\n"); });
+    table->put(launchpad_pages::slot(7, 7), button);
 
-    button->set_color(launchpad::commands::calculate_velocity(commands::led_brightness::low, commands::led_brightness::high));
-    page->at(7)[6] = button;
+    button = config::ButtonComplexMacro([]() { _DebugString("lol\n"); });
+
+    button.set_color(launchpad::commands::calculate_velocity(commands::led_brightness::low, commands::led_brightness::high));
+    table->put(launchpad_pages::slot(7, 6), button);
 
 
     https://onlineunicodetools.com/convert-unicode-to-hex use UCS-2-BE
@@ -313,184 +495,122 @@ void midi_device::launchpad::Launchpad::setup_pages_test()
             0x0 // null terminator
     };
     std::wstring test = std::wstring(ste);
-    button = new config::ButtonStringMacro(test);
-    button->set_color(launchpad::commands::calculate_velocity(commands::led_brightness::low, commands::led_brightness::low));
-    page->at(7)[5] = button;
+    button = config::ButtonStringMacro(test);
+    button.set_color(launchpad::commands::calculate_velocity(commands::led_brightness::low, commands::led_brightness::low));
+    table->put(launchpad_pages::slot(7, 5), button);
 
     // mute
-    button = new config::ButtonSimpleKeycodeTest(VK_F13);
-    button->set_color(launchpad::commands::vel_yellow_full);
-    page->at(7)[0] = button;
+    button = config::ButtonSimpleKeycodeTest(VK_F13);
+    button.set_color(launchpad::commands::vel_yellow_full);
+    table->put(launchpad_pages::slot(7, 0), button);
 
     // deafen
-    button = new config::ButtonSimpleKeycodeTest(VK_F14);
-    button->set_color(launchpad::commands::vel_red_low);
-    page->at(7)[1] = button;
+    button = config::ButtonSimpleKeycodeTest(VK_F14);
+    button.set_color(launchpad::commands::vel_red_low);
+    table->put(launchpad_pages::slot(7, 1), button);
 
-    button = new config::ButtonSimpleKeycodeTest('a');
-    button->set_color(launchpad::commands::calculate_velocity(commands::led_brightness::high, commands::led_brightness::high));
-    page->at(6)[4] = button;
+    button = config::ButtonSimpleKeycodeTest('a');
+    button.set_color(launchpad::commands::calculate_velocity(commands::led_brightness::high, commands::led_brightness::high));
+    table->put(launchpad_pages::slot(6, 4), button);
 
-    pages.push_back(page);
+    pages.publish(table);
+    loader.forget();
 }
 
 void midi_device::launchpad::Launchpad::load_config_buttons_test() {
-    try {
-        /*if (::config::config_file.at("devices").contains("Launchpad_S")) {
-            return;
-        }*/
-
-        // why
-        if (!::config::config_file.at("devices").at("Launchpad_S").is_object()) {
-            return;
-        }
-
-        nlohmann::json& config = ::config::config_file.at("devices").at("Launchpad_S");
-        pages.clear();
-        // FIXME: hard limit of 8 pages by buttons but this should be handled better.
-        pages.resize(8);
-
-        for (auto& [page, buttons] : config.at("session").items()) {
-            int index = std::stoi(page);
-            launchpad_grid* page_buttons = new launchpad_grid{ nullptr };
-
-            if (!buttons.is_array()) {
-                _DebugString("lol you're fucked\n");
-            }
-
-            for (auto& button : buttons) {
-                std::string type = button.at("type");
-                int position_x = button.at("position").at(0);
-                int position_y = button.at("position").at(1);
-                unsigned char color = commands::calculate_velocity(1, 2);
+    this->load_pages(false);
+}
 
-                config::ButtonBase* new_button;
+// the config's pages for us. without a Launchpad_S in the config the live pages stay, or with
+// test_pages_otherwise the test page goes up instead.
+void midi_device::launchpad::Launchpad::load_pages(bool test_pages_otherwise) {
+    std::lock_guard<std::mutex> pages_lock(pages_mutex);
+    std::shared_ptr<const ::config::compiled_config> compiled = ::config::current();
+    const ::config::device_record* device = compiled->find_device("Launchpad_S");
 
-                if (type == "key_test") {
-                    if (!button.at("data").is_number()) {
-                        continue;
-                    }
+    if (device == nullptr) {
+        if (test_pages_otherwise) {
+            this->publish_test_pages();
+        }
+        return;
+    }
 
-                    new_button = new config::ButtonSimpleKeycodeTest(button.at("data"));
+    const ::config::settings& settings = device->device_settings;
 
-                }
-                else if (type == "key_string") {
-                    if (!button.at("data").is_string()) {
-                        continue;
-                    }
+    {
+        std::lock_guard<std::mutex> lock(led_mutex);
+        bool buffered = settings.value(::config::setting::double_buffered, true);
 
-                    new_button = new config::ButtonStringMacro(string_to_wstring(button.at("data")));
-                }
-                else {
-                    new_button = new config::ButtonSimpleKeycodeTest('b');
-                }
+        if (buffered != double_buffered) {
+            double_buffered = buffered;
+            this->selectBuffers();
+            writer.wake(false);
+        }
 
-                new_button->set_color(color);
+        writer.set_profile({
+            settings.value(::config::setting::output_rate, default_output_profile.bytes_per_second),
+            settings.value(::config::setting::output_burst, default_output_profile.burst_bytes) });
 
-                page_buttons->at(position_x).at(position_y) = new_button;
-            }
-            
-            pages.at(index) = page_buttons;
+        // rewrites the top left LED with what it should already show.
+        if (settings.value(::config::setting::calibrate_output, false)) {
+            launchpad::commands::midi_message message = launchpad::commands::led_on(0x00, leds.get(led_grid_cell(0, 0)));
+            writer.calibrate(message.data(), message.size(), calibration_messages);
         }
     }
-    catch (std::invalid_argument& e) {
-        _DebugString("invalid args!\n");
-    }
-    catch (nlohmann::json::type_error& e) {
-        _DebugString("type error!\n");
-    }
-    catch (nlohmann::json::out_of_range &e) {
-        _DebugString("range error!\n");
+    // FIXME: hard limit of 8 pages by buttons but this should be handled better.
+    constexpr size_t page_count = 8;
+
+    // editing one button only builds and repaints that one, see page_loader.
+    std::vector<size_t> changed;
+    bool incremental = loader.load(pages, compiled, *device, mode_count, page_count, [](const ::config::compiled_config& source, const ::config::button_record& record) {
+        // whatever the type, the registry knows how to build it.
+        config::Button button = macropad::buttons::make(source, record);
+        button.set_color(commands::calculate_velocity(1, 2));
+        return button;
+    }, changed);
+
+    // the live pages weren't from a config (test pages, first load), nothing to go by but a full repaint.
+    if (!incremental) {
+        this->fullLedUpdate();
+        return;
     }
 
-}
-
-
-void midi_device::launchpad::Launchpad::TerminateDevice()
-{
-    execute_all = false;
-}
-
-void midi_device::launchpad::config::ButtonSimpleKeycodeTest::execute()
-{
-    if (keycode == -1) {
+    if (changed.empty()) {
         return;
     }
 
-    INPUT input;
+    std::shared_ptr<const launchpad_pages> table = pages.load();
+    std::lock_guard<std::mutex> lock(led_mutex);
 
-    input.type = INPUT_KEYBOARD;
-    input.ki.time = 0;
-    input.ki.wScan = NULL;
-    input.ki.dwExtraInfo = NULL;
+    // published first: a page switch from here on already renders the new table, we only patch the page showing.
+    // the cells line up with the table, a page is page_slots of them in a row.
+    const size_t showing = mode_index(mode) * page_count + page;
 
-    input.ki.wVk = keycode;
-    input.ki.dwFlags = 0;
-
-    // send
-    SendInput(1, &input, sizeof(INPUT));
-
-    // wait
-    Sleep(100);
-
-    // release
-    input.ki.dwFlags = KEYEVENTF_KEYUP;
-    SendInput(1, &input, sizeof(INPUT));
-
-}
-
-void midi_device::launchpad::config::ButtonComplexMacro::execute()
-{
-    this->func();
-}
-
-void midi_device::launchpad::config::ButtonStringMacro::execute()
-{
-    for (const wchar_t a : string) {
-        INPUT input;
-
-        input.type = INPUT_KEYBOARD;
-        input.ki.time = 0;
-        input.ki.wScan = a;
-        input.ki.dwExtraInfo = NULL;
-
-        input.ki.wVk = NULL;
-        input.ki.dwFlags = KEYEVENTF_UNICODE;
-
-        // send
-        SendInput(1, &input, sizeof(INPUT));
-
-        // wait
-        Sleep(1);
+    for (size_t cell : changed) {
+        if (cell / launchpad_pages::page_slots != showing) {
+            continue;
+        }
 
-        // release
-        input.ki.dwFlags = KEYEVENTF_KEYUP;
-        SendInput(1, &input, sizeof(INPUT));
+        size_t slot = cell % launchpad_pages::page_slots;
+        config::Button* button = table->get(mode_index(mode), page, slot);
+        layers.set_base(led_grid_cell(slot / 8, slot % 8), button == nullptr ? launchpad::commands::vel_off_off : static_cast<unsigned char>(button->get_color()));
 
-        Sleep(1);
+        if (button != nullptr) {
+            layers.pulse(led_grid_cell(slot / 8, slot % 8), launchpad::commands::vel_off_off, static_cast<unsigned char>(button->get_color()), reload_pulse_period_ms, reload_pulse_ms);
+        }
     }
-}
 
-std::wstring midi_device::launchpad::config::ButtonStringMacro::to_wstring()
-{
-    return L"midi_device::launchpad::config::ButtonStringMacro : color=" + std::to_wstring(this->get_color()) + L" str=\"" + this->string + L"\"";
+    this->compose();
+    writer.wake();
 }
 
 
-std::wstring midi_device::launchpad::config::ButtonBase::to_wstring()
-{
-    return L"midi_device::launchpad::config::ButtonBase : empty button";
-}
-
-std::wstring midi_device::launchpad::config::ButtonComplexMacro::to_wstring()
+void midi_device::launchpad::Launchpad::TerminateDevice()
 {
-    std::wstringstream buffer;
-    buffer << std::hex << &this->func;
+    execute_all = false;
 
-    return L"midi_device::launchpad::config::ButtonComplexMacro : color=" + std::to_wstring(this->get_color()) + L" func_ptr=" + buffer.str();
+    // kick the input thread out of waitForMessage.
+    if (main_device != nullptr) {
+        main_device->in->cancelWait();
+    }
 }
-
-std::wstring midi_device::launchpad::config::ButtonSimpleKeycodeTest::to_wstring()
-{
-    return L"midi_device::launchpad::config::ButtonSimpleKeycodeTest : color=" + std::to_wstring(this->get_color()) + L" keycode=" + std::to_wstring(this->keycode);
-}
\ No newline at end of file
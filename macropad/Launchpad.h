@@ -1,8 +1,22 @@
 #pragma once
 #include "RtMidi.h"
 #include "MidiDevice.h"
+#include "InputEvent.h"
+#include "Button.h"
+#include "KeyInjector.h"
+#include "LedFramebuffer.h"
+#include "LedWriter.h"
+#include "LedLayers.h"
+#include "Animation.h"
+#include "PageTable.h"
 #include <wchar.h>
+#include <array>
 #include <functional>
+#include <mutex>
+
+namespace config {
+    struct compiled_config;
+}
 
 // this namespace organization does not make any sense.
 namespace midi_device::launchpad {
@@ -14,52 +28,59 @@ namespace midi_device::launchpad {
     };
 
     namespace config {
-        class ButtonBase {
-            unsigned char color;
-        public:
-            ButtonBase() : color(0x0C) {}
-            virtual ~ButtonBase() {}
-            virtual void execute() = 0;
-            virtual std::wstring to_wstring() = 0;
-            inline void set_color(unsigned char col) { color = col; };
-            inline unsigned char get_color() { return color; };
-        };
+        // the buttons are the same on every device now, see Button.h.
+        using macropad::buttons::Button;
+        using macropad::buttons::ButtonSimpleKeycodeTest;
+        using macropad::buttons::ComplexMacroFn;
+        using macropad::buttons::ButtonComplexMacro;
+        using macropad::buttons::ButtonStringMacro;
+    }
 
-        class ButtonSimpleKeycodeTest : public ButtonBase {
-            int keycode;
-        public:
-            ButtonSimpleKeycodeTest() : keycode(-1) {}
-            ButtonSimpleKeycodeTest(int keycode) : keycode(keycode) {}
-            void execute();
-            std::wstring to_wstring();
-        };
+    typedef page_table<launchpad::config::Button> launchpad_pages;
 
-        typedef std::function<void()> ComplexMacroFn;
+    // every mode has its own pages, in enum order.
+    constexpr size_t mode_count = 4;
+    constexpr size_t mode_index(mode current) { return static_cast<size_t>(current) - static_cast<size_t>(mode::session); }
 
-        class ButtonComplexMacro : public ButtonBase {
-            ComplexMacroFn func;
-        public:
-            ButtonComplexMacro(ComplexMacroFn fun) : func(fun) {}
-            void execute();
-            std::wstring to_wstring();
-        };
+    // lol temp
+    extern bool execute_all;
 
-        class ButtonStringMacro : public ButtonBase {
-            std::wstring string;
-        public:
-            ButtonStringMacro(std::wstring str) : string(str) {}
-            void execute();
-            std::wstring to_wstring();
-        };
-    }
+    // upper bound on how long the input thread stays parked before re-checking should_loop.
+    constexpr unsigned int input_wait_timeout_ms = 250;
 
-    typedef std::array<launchpad::config::ButtonBase*, 8> launchpad_row;
-    typedef std::array<std::array<launchpad::config::ButtonBase*, 8>, 8> launchpad_grid;
+    // input ring capacity. sized for clock messages plus pad mashing between wakeups.
+    constexpr unsigned int input_queue_size = 1024;
 
-    // lol temp
-    extern bool execute_all;
+    // max messages handled per wakeup.
+    constexpr unsigned int input_batch_size = 64;
+
+    // about 1000 LED messages a second, and a whole pad's worth at once. a guess that holds up on the pads we
+    // have; "output_rate"/"output_burst" in the config override it, "calibrate_output" measures it.
+    constexpr output_profile default_output_profile = { 3000, 240 };
+
+    // LED messages timed by calibrate_output.
+    constexpr size_t calibration_messages = 200;
+
+    // a released button fades from the press color back to its own over this long.
+    constexpr unsigned int release_fade_ms = 150;
 
-    class Launchpad : public MidiDeviceBase {
+    // a button a reload changed pulses between off and its new color for a bit, so the edit can be seen landing.
+    constexpr unsigned int reload_pulse_period_ms = 400;
+    constexpr unsigned int reload_pulse_ms = 1200;
+
+    // blends two velocities one channel at a time (4 levels each, so it's steppy). the flag bits (buffers,
+    // flashing) come from whichever side is closer.
+    struct velocity_mix {
+        unsigned char operator()(unsigned char from, unsigned char to, unsigned int t) const {
+            unsigned int green = ((from >> 4) & 0x03) * (led_mix_max - t) + ((to >> 4) & 0x03) * t;
+            unsigned int red = (from & 0x03) * (led_mix_max - t) + (to & 0x03) * t;
+            unsigned char flags = (t < led_mix_max / 2 ? from : to) & 0x0C;
+
+            return static_cast<unsigned char>(0x10 * ((green + led_mix_max / 2) / led_mix_max) + (red + led_mix_max / 2) / led_mix_max + flags);
+        }
+    };
+
+    class Launchpad : public MidiDeviceBase, public macropad::animation::target {
         
         // TODO: multiple device support and think of an actual working execution flow which makes sense 
         // what the FUCK is this shit
@@ -68,21 +89,53 @@ namespace midi_device::launchpad {
         bool should_loop;
         void Loop();
 
-        launchpad::config::ButtonBase* get_button(unsigned char num);
+        launchpad::config::Button* get_button(const launchpad_pages& table, unsigned char slot);
 
         mode mode = mode::session;
         unsigned int page = 0;
 
-        std::vector<launchpad_grid*> pages;
+        // swapped whole by a config (re)load, see PageTable.h.
+        page_table_slot<launchpad::config::Button> pages;
+        // what the live pages were built from, a reload only rebuilds what differs from it.
+        page_loader<launchpad::config::Button> loader;
+        // one page build at a time, the window and the device thread can both start one.
+        std::mutex pages_mutex;
+        void load_pages(bool test_pages_otherwise);
+        void publish_test_pages();
+
+        // velocities, see commands::calculate_velocity.
+        led_framebuffer<unsigned char> leds;
+        // the page plus effects, composed into leds.
+        led_layers<unsigned char, velocity_mix> layers;
+        // the window thread refreshes/resets too.
+        std::mutex led_mutex;
+        // owns the output port, see LedWriter.h. everything that sends goes through it.
+        led_writer writer{ led_mutex, [this](size_t budget) { return this->flushLeds(budget); }, default_output_profile };
+        // the next flush is a whole page, see presentFrame().
+        bool frame_pending = false;
+        // some of that page is in the hidden buffer already.
+        bool frame_drawn = false;
+        void render();
+        void compose();
+        bool flushLeds(size_t budget);
+        void presentLeds(size_t limit);
+        bool presentFrame(size_t limit);
+        void sendLed(size_t cell, unsigned char velocity);
+
+        // whole frames (page/mode changes) are drawn into the hidden buffer and flipped in, so the pad never shows
+        // a half drawn page. small updates still go straight to both buffers.
+        bool double_buffered = true;
+        unsigned char displayed_buffer = 0;
+        void selectBuffers();
 
     public:
         Launchpad() : should_loop(true) {
-            in = new RtMidiIn();
+            in = new RtMidiIn(RtMidi::UNSPECIFIED, "RtMidi Input Client", input_queue_size);
             out = new RtMidiOut();
         };
 
         void Init();
-        void sendMessage(unsigned char* message);
+        void sendMessage(const std::array<unsigned char, 3>& message);
         void fullLedUpdate();
         void setup_pages_test();
 
@@ -95,13 +148,12 @@ namespace midi_device::launchpad {
 
         void load_config_buttons_test();
 
-        inline launchpad_grid* getCurrentButtons() {
-            if (page >= pages.size()) {
-                return nullptr;
-            }
+        bool animate(std::chrono::steady_clock::time_point now) override;
 
-            return pages.at(page);
-        };
+        // the live pages. keep the pointer for as long as buttons out of it are used.
+        inline std::shared_ptr<const launchpad_pages> getPages() const { return pages.load(); }
+        inline unsigned int getPage() const { return page; }
+        inline size_t getModeIndex() const { return mode_index(mode); }
 
 
         static void RunDevice();
@@ -109,27 +161,44 @@ namespace midi_device::launchpad {
 
         // testing purposes thing proof of consept 1 device thing
         // please fix later
-        inline static Launchpad* GetDevice() { return reinterpret_cast<Launchpad*>(midi_device::devices.at(0)); }
+        // nullptr until the device is up.
+        // devices holds the MidiDeviceBase part, which isn't at the start of the object (animation::target is
+        // polymorphic and goes first), so this has to be a static_cast.
+        inline static Launchpad* GetDevice()
+        {
+            std::lock_guard<std::mutex> lock(midi_device::devices_mutex);
+            return midi_device::devices.empty() ? nullptr : static_cast<Launchpad*>(midi_device::devices.at(0));
+        }
     };
 
-    enum class message_type {
-        invalid = 0x0,
-        grid_depressed = 0x90,
-        grid_pressed = 0x90 + 0x7F,
-        grid_page_change_depressed = 0x90 + 0x7F + 0x1,
-        grid_page_change_pressed = 0x90 + 0x7F + 0x2,
-        automap_live_depressed = 0xB0,
-        automap_live_pressed = 0xB0 + 0x7F
-    };
+    // notes are 0x10 * row + column. column 8 is the scene launch column, which we use for pages.
+    constexpr input_key_table make_input_keys() {
+        input_key_table table{};
 
-    class input {
-    public:
-        std::vector<unsigned char> message;
+        for (unsigned char row = 0; row < 8; ++row) {
+            for (unsigned char col = 0; col < 9; ++col) {
+                table[0x10 * row + col] = input_key{ col == 8 ? input_kind::page_pressed : input_kind::grid_pressed, row, col, static_cast<unsigned char>(launchpad_pages::slot(row, col)) };
+            }
+        }
 
-        input(std::vector<unsigned char> msg) : message(msg) {};
-        message_type message_type();
-        unsigned char keycode();
-    };
+        add_control_keys(table);
+        return table;
+    }
+
+    inline constexpr input_key_table input_keys = make_input_keys();
+
+    // corners of the grid and the page column, both ways.
+    static_assert(decode_message(input_keys, 0x90, 0x00, 0x7F).kind == input_kind::grid_pressed
+        && decode_message(input_keys, 0x90, 0x00, 0x7F).slot == 0, "0x00 is the top left pad");
+    static_assert(decode_message(input_keys, 0x80, 0x77, 0x40).kind == input_kind::grid_released
+        && decode_message(input_keys, 0x80, 0x77, 0x40).slot == 63, "0x77 is the bottom right pad");
+    static_assert(decode_message(input_keys, 0x90, 0x08, 0x7F).kind == input_kind::page_pressed
+        && decode_message(input_keys, 0x90, 0x08, 0x7F).x == 0, "0x08 is page 0");
+    static_assert(decode_message(input_keys, 0x90, 0x78, 0x00).kind == input_kind::page_released
+        && decode_message(input_keys, 0x90, 0x78, 0x00).x == 7, "0x78 is page 7");
+    static_assert(decode_message(input_keys, 0x90, 0x09, 0x7F).kind == input_kind::invalid
+        && decode_message(input_keys, 0x90, 0x79, 0x7F).kind == input_kind::invalid, "nothing past the page column");
+    static_assert(decode_message(input_keys, 0xB0, 104, 0x7F).kind == input_kind::control_pressed, "the top row is cc 104 - 111");
 
     // look at the Launchpad Programmers Reference.
     namespace commands {
@@ -147,6 +216,7 @@ namespace midi_device::launchpad {
         constexpr unsigned char vel_red_full = 0x0F;
 
         constexpr unsigned char vel_yellow_full = 0x3E;
+        constexpr unsigned char vel_green_full = 0x3C;
 
         constexpr unsigned char vel_red_full_flashing = 0x0B;
 
@@ -158,19 +228,37 @@ namespace midi_device::launchpad {
             return (0x10 * green) + red + flags;
         }
 
-        inline unsigned char* controller_change(unsigned char controller, unsigned char data) {
-            return new unsigned char[3] { 0xB0, controller, data};
+        // every message we send the S is 3 bytes, built on the stack.
+        typedef std::array<unsigned char, 3> midi_message;
+
+        constexpr midi_message controller_change(unsigned char controller, unsigned char data) {
+            return { 0xB0, controller, data };
         }
 
         // note: don't use these two functions for setting the LEDS for the automap/ Live control LEDs, they are 0xB0.
-        inline unsigned char* led_off(unsigned char key, unsigned char velocity) {
-            return new unsigned char[3] { 0x80, key, velocity};
+        constexpr midi_message led_off(unsigned char key, unsigned char velocity) {
+            return { 0x80, key, velocity };
+        }
+
+        constexpr midi_message led_on(unsigned char key, unsigned char velocity) {
+            return { 0x90, key, velocity };
+        }
+
+        // two LEDs per message. 64 grid LEDs row by row, then the scene column top to bottom, then the top row.
+        // any other message sends the cursor back to the start.
+        constexpr midi_message rapid_update(unsigned char first, unsigned char second) {
+            return { 0x92, first, second };
         }
 
-        inline unsigned char* led_on(unsigned char key, unsigned char velocity) {
-            return new unsigned char[3] { 0x90, key, velocity};
+        // double buffering, sent as controller 0x00. copy makes the update buffer a copy of the displayed one.
+        constexpr unsigned char buffer_select(unsigned char display, unsigned char update, bool copy) {
+            return 0x20 | (copy ? 0x10 : 0x00) | (update << 2) | display;
         }
 
+        // velocity bits that write to both buffers (calculate_velocity sets them). without them a write only
+        // touches the buffer being updated.
+        constexpr unsigned char velocity_flags = 0x0C;
+
         inline unsigned char calculate_grid(unsigned char row, unsigned char column) {
             return (0x10 * row) + column;
         }
@@ -180,9 +268,9 @@ namespace midi_device::launchpad {
             y = keycode % 0x10;
         }
 
-        constexpr unsigned char reset[3] = { 0xB0, 0x00, 0x00 };
-        constexpr unsigned char brightness_test_low[3] = { 0xB0, 0x00, 0x7D };
-        constexpr unsigned char brightness_test_med[3] = { 0xB0, 0x00, 0x7E };
-        constexpr unsigned char brightness_test_full[3] = { 0xB0, 0x00, 0x7F };
+        constexpr midi_message reset = { 0xB0, 0x00, 0x00 };
+        constexpr midi_message brightness_test_low = { 0xB0, 0x00, 0x7D };
+        constexpr midi_message brightness_test_med = { 0xB0, 0x00, 0x7E };
+        constexpr midi_message brightness_test_full = { 0xB0, 0x00, 0x7F };
     }
 };
\ No newline at end of file
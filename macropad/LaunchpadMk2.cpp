@@ -6,6 +6,10 @@
 #include "LaunchpadMk2.h"
 #include "macropad.h"
 #include "Config.h"
+#include "Trace.h"
+#include "Executor.h"
+#include "Scheduler.h"
+#include "Animation.h"
 
 bool midi_device::launchpadmk2::execute_all = true;
 
@@ -61,10 +65,27 @@ void midi_device::launchpadmk2::LaunchpadMk2::Init()
         }
     }
 
-    this->setup_pages_test();
-    this->fullLedUpdate();
+    writer.start(out);
+
+    // start from a known blank state (one clear-all message), from here on only changes get sent.
+    if (out->isPortOpen()) {
+        std::lock_guard<std::mutex> lock(led_mutex);
+        this->sendMessage(commands::led_setAll(0));
+        leds.assume(commands::palette(0));
+        writer.wake(false);
+    }
 
-    devices.push_back(this);
+    macropad::animation::add(this);
+
+    // in devices before the first load, see the S.
+    {
+        std::lock_guard<std::mutex> lock(devices_mutex);
+        devices.push_back(this);
+    }
+
+    // config pages if there's a config for us, the test page otherwise.
+    this->load_pages(true);
+    this->fullLedUpdate();
 }
 
 void midi_device::launchpadmk2::LaunchpadMk2::reset()
@@ -80,291 +101,244 @@ void midi_device::launchpadmk2::LaunchpadMk2::RunDevice()
     main_device->Loop();
 }
 
-midi_device::launchpadmk2::message_type midi_device::launchpadmk2::input::message_type() {
-    launchpadmk2::message_type type =
-        static_cast<launchpadmk2::message_type>(message.at(0) + message.at(2));
-
-    // this shouldn't happen...
-    if (type > message_type::automap_live_pressed || type < message_type::grid_depressed) {
-        return message_type::invalid;
-    }
-
-    if (message.at(1) % 0x0A == 0x09) {
-        if (type == message_type::grid_depressed) {
-            return message_type::grid_page_change_depressed;
-        }
-        else if (type == message_type::grid_pressed) {
-            return message_type::grid_page_change_pressed;
-        }
-    }
-
-    return static_cast<launchpadmk2::message_type>(message.at(0) + message.at(2));
-}
-
-unsigned char midi_device::launchpadmk2::input::keycode() {
-    return message.at(1);
-}
-
 /// Input loop
 void midi_device::launchpadmk2::LaunchpadMk2::Loop()
 {
     std::vector<unsigned char> message;
-    int nBytes, i;
-    double stamp;
-    config::ButtonBase* button;
+    std::array<RtMidiEvent, input_batch_size> events;
+    unsigned int count, n;
+    bool needs_full_update;
+    config::Button* button;
+    std::shared_ptr<const launchpad_pages> table;
 
 	while (should_loop && execute_all)
 	{
-        stamp = in->getMessage(&message);
-        nBytes = message.size();
-
-        // no message. skip
-        if (nBytes == 0) {
+        // sleep until the driver queues something instead of spinning on getMessage.
+        if (!in->waitForMessage(input_wait_timeout_ms)) {
+            // quiet, a good time to free pages a reload left behind.
+            pages.reclaim();
             continue;
         }
 
-        for (i = 0; i < nBytes; i++)
-            _DebugString("Byte " + std::to_string(i) + " = " + std::to_string((int)message[i]) + ", ");
-        if (nBytes > 0)
-            _DebugString("stamp = " + std::to_string(stamp) + "\n");
+        count = in->getMessages(events.data(), static_cast<unsigned int>(events.size()));
 
-        if (nBytes != 3)
+        // nothing short at the front of the queue, so it's sysex. we don't use it, drop it.
+        if (count == 0) {
+            in->getMessage(&message);
+            MACROPAD_TRACE(info, sysex_ignored, static_cast<unsigned int>(message.size()), 0.0);
             continue;
+        }
 
-        input input = launchpadmk2::input(message);
-
-		switch (input.message_type())
-		{
-        case message_type::grid_pressed:
-	        {
-	            this->sendMessageSysex(commands::led_setPalette(input.keycode(), 49));
-	            break;
-	        }
-        case message_type::grid_depressed:
-	        {
-	            button = get_button(input.keycode());
-
-        		if (button == nullptr)
-        		{
-	                this->sendMessageSysex(commands::led_off(input.keycode()));
-        		}
-        		else
-        		{
-	                button->execute();
-	                this->sendMessageSysex(commands::led_set(input.keycode(), button->get_color()));
-        		}
-	            break;
-	        }
-        case message_type::grid_page_change_pressed:
-	        {
-				// change page.
-	            page = message[1] / 0x0B - 1;
-
-        		// update all buttons
-                this->fullLedUpdate();
-	        }
-        case message_type::automap_live_depressed:
-			{
-				break;
-			}
-		}
-		
-        button = nullptr;
-        message.clear();
-	}
-
-    // end of loop. reset
-    this->reset();
-}
-
-midi_device::launchpadmk2::config::ButtonBase* midi_device::launchpadmk2::LaunchpadMk2::get_button(unsigned char key)
-{
-    if (page >= pages.size()) {
-        return nullptr;
-    }
+        MACROPAD_TRACE(verbose, input_wake, count, in->getWakeLatency());
+
+        // page changes only need one repaint per batch, no matter how many came in.
+        needs_full_update = false;
+
+        // one table for the whole batch. a reload publishing meanwhile shows up in the next one.
+        table = pages.load();
+
+        std::lock_guard<std::mutex> lock(led_mutex);
+
+        for (n = 0; n < count; n++)
+        {
+            const RtMidiEvent& event = events[n];
+
+            MACROPAD_TRACE(verbose, midi_in, macropad::trace::pack(event.bytes[0], event.bytes[1], event.bytes[2]), event.timeStamp);
+
+            const input_event input = decode_input(input_keys, event);
+
+		    switch (input.kind)
+		    {
+            case input_kind::grid_pressed:
+	            {
+	                layers.press(led_grid_cell(input.x, input.y), commands::palette(49));
+	                break;
+	            }
+            case input_kind::grid_released:
+	            {
+	                button = get_button(*table, input.slot);
+
+        		    if (button == nullptr)
+        		    {
+	                    layers.release(led_grid_cell(input.x, input.y), 0);
+        		    }
+        		    else
+        		    {
+	                    // never run the action here, the input thread would be stuck until it's done.
+	                    macropad::executor::post_execute(button);
+	                    layers.release(led_grid_cell(input.x, input.y), release_fade_ms);
+
+	                    // a paced string fills the top row up while it types.
+	                    if (unsigned int typing_ms = button->duration_ms())
+	                        layers.timed_progress(led_control_cell(0), led_columns, commands::palette(21), typing_ms);
+        		    }
+	                break;
+	            }
+            case input_kind::page_pressed:
+	            {
+				    // change page.
+	                page = input.x;
+
+        		    // update all buttons
+                    needs_full_update = true;
+                    break;
+	            }
+            default:
+			    {
+				    break;
+			    }
+		    }
+
+            button = nullptr;
+        }
 
-    if (pages.at(page) == nullptr) {
-        return nullptr;
-    }
+        if (needs_full_update) {
+            this->render();
+        }
 
-    int x, y;
-    commands::calculate_xy_from_keycode(key, x, y);
+        this->compose();
 
-    return pages.at(page)->at(x).at(y);
-}
+        // whatever changed in this batch goes out together, from the writer thread.
+        writer.wake();
 
-// custom calculated messages go here
-void midi_device::launchpadmk2::LaunchpadMk2::sendMessage(unsigned char* message) 
-{
-    if (!out->isPortOpen()) {
-        goto cleanup;
-    }
+        // let go before sleeping, a swapped out table is only freed once nobody holds it.
+        table.reset();
+        pages.reclaim();
+	}
 
-    try {
-        out->sendMessage(message, sizeof(unsigned char) * 5);
-    }
-    catch (RtMidiError& error) {
-        error.printMessage();
-        _DebugString(error.getMessage());
+    if (in->getOverflowCount() > 0) {
+        MACROPAD_TRACE(error, input_overflow, static_cast<unsigned int>(in->getOverflowCount()), 0.0);
     }
 
-cleanup:
-    delete[] message;
+    // end of loop. reset
+    macropad::animation::remove(this);
+    this->reset();
+    writer.stop();
 }
-void midi_device::launchpadmk2::LaunchpadMk2::sendMessage(std::vector<unsigned char> messageOut) 
-{
-    if (!out->isPortOpen()) {
-        return;
-    }
 
-    try {
-        out->sendMessage(messageOut.data(), messageOut.size());
-    }
-    catch (RtMidiError& error) {
-        error.printMessage();
-        _DebugString(error.getMessage());
-    }
+midi_device::launchpadmk2::config::Button* midi_device::launchpadmk2::LaunchpadMk2::get_button(const launchpad_pages& table, unsigned char slot)
+{
+    return table.get(mode_index(mode), page, slot);
 }
 
-// sysex messages go here
-void midi_device::launchpadmk2::LaunchpadMk2::sendMessageSysex(unsigned char* message, size_t size)
+// every message goes through here, prebuilt (see commands). queued for the writer, call with led_mutex held.
+void midi_device::launchpadmk2::LaunchpadMk2::sendMessage(const unsigned char* message, size_t size)
 {
-    unsigned char header[]{ 0xF0, 0x00, 0x20, 0x29, 0x02, 0x18 };
-
-    // custom message payload
-    std::vector<unsigned char> messageOut;
-
-    if (!out->isPortOpen())
-        goto cleanup;
-
-    // add header to start
-    messageOut.insert(messageOut.begin(), std::begin(header), std::end(header));
-
-    for (size_t i = 0; i < size; ++i) {
-        messageOut.push_back(message[i]);
-    }
+    writer.post(message, size);
+}
 
-    // add header to end
-    messageOut.push_back(static_cast<unsigned char>(0xF7));
+// draws the current page into the base layer. nothing shows until compose().
+void midi_device::launchpadmk2::LaunchpadMk2::render()
+{
+    layers.fill_base(commands::palette(0));
 
-    try
+    // page indicators, the current page in color 12, yellow
+	// REFER TO THE MK2 PROGRAMMER'S MANUAL!!!!
+    for (size_t row = 0; row < led_rows; ++row)
     {
-        out->sendMessage(messageOut.data(), messageOut.size());
+        layers.set_base(led_grid_cell(row, 8), commands::palette(15));
     }
-    catch (RtMidiError& error)
+
+    if (page < led_rows)
     {
-        error.printMessage();
-        _DebugString(error.getMessage());
+        layers.set_base(led_grid_cell(page, 8), commands::palette(12));
     }
 
-cleanup:
-    delete[] message;
-}
-void midi_device::launchpadmk2::LaunchpadMk2::sendMessageSysex(std::vector<unsigned char> messageOut)
-{
-    unsigned char header[]{ 0xF0, 0x00, 0x20, 0x29, 0x02, 0x18 };
-
-    if (!out->isPortOpen())
-        return;
+    // set our "mode" indicator
+    layers.set_base(led_control_cell(static_cast<size_t>(mode)), commands::palette(12));
 
-    // add header to start
-    messageOut.insert(messageOut.begin(), std::begin(header), std::end(header));
+    std::shared_ptr<const launchpad_pages> table = pages.load();
+    config::Button* buttons = table->page_buttons(mode_index(mode), page);
 
-    // add header to end
-    messageOut.push_back(static_cast<unsigned char>(0xF7));
+    if (buttons == nullptr)
+        return;
 
-    try
-    {
-        out->sendMessage(messageOut.data(), messageOut.size());
-    }
-    catch (RtMidiError& error)
-    {
-        error.printMessage();
-        _DebugString(error.getMessage());
+    for (size_t slot = 0; slot < launchpad_pages::page_slots; ++slot) {
+        if (!buttons[slot].empty()) {
+            layers.set_base(led_grid_cell(slot / 8, slot % 8), buttons[slot].get_color());
+        }
     }
 }
 
-// clear the grid
-void midi_device::launchpadmk2::LaunchpadMk2::clearGrid()
+// layers into the framebuffer, led_mutex held. the writer still has to be woken.
+void midi_device::launchpadmk2::LaunchpadMk2::compose()
 {
-	for (size_t row = 0; row < 8; ++row)
-	{
-		for (size_t column = 0; column < 8; ++column)
-		{
-            this->sendMessageSysex(commands::led_off(commands::calculate_grid(row, column)));
-		}
-	}
+    if (layers.compose(leds))
+        macropad::animation::wake();
 }
 
+// animation thread.
+bool midi_device::launchpadmk2::LaunchpadMk2::animate(std::chrono::steady_clock::time_point now)
+{
+    std::lock_guard<std::mutex> lock(led_mutex);
 
-// this will literally update EVERYTHING. do NOT call this function unless you ABSOLUTELY NEED TO!
-void midi_device::launchpadmk2::LaunchpadMk2::fullLedUpdate()
+    if (!layers.animating())
+        return false;
+
+    bool moving = layers.compose(leds, now);
+    writer.wake();
+    return moving;
+}
+
+// sends the cells that differ from what the pad shows, as many as the budget (bytes) covers, press feedback
+// first. writer thread, led_mutex held. returns true if some of it has to wait for the next round.
+bool midi_device::launchpadmk2::LaunchpadMk2::presentLeds(size_t budget)
 {
-    // don't do anything.
+    // don't do anything. the shadow stays as it was, so it's all sent once the port is there.
     if (!out->isPortOpen())
-        return;
+        return false;
 
-    // reset everything first.
-    out->sendMessage(commands::reset, sizeof(unsigned char) * 5);
+    // worst case an RGB entry per cell, plus the framing of one palette and one RGB frame.
+    constexpr size_t framing = 2 * (sizeof(commands::sysex_header) + 2);
+    size_t limit = budget > framing ? (budget - framing) / 4 : 0;
 
-    // clear page indicators
-    for (size_t row = 0; row < 8; ++row)
-    {
-        this->sendMessageSysex(commands::led_setPalette(commands::calculate_grid(row, 8), 15));
-    }
+    leds.present([this](size_t cell, unsigned int color) {
+        // the top row takes the same sysex LED messages, as 104 - 111.
+        unsigned char key = led_is_control(cell)
+            ? static_cast<unsigned char>(104 + led_cell_control(cell))
+            : commands::calculate_grid(static_cast<unsigned char>(led_cell_row(cell)), static_cast<unsigned char>(led_cell_column(cell)));
 
-    // set our page indicator to color 12, yellow
-	// REFER TO THE MK2 PROGRAMMER'S MANUAL!!!! i should probably do this programatically
-    this->sendMessageSysex(commands::led_setPalette(
-        0x0A * page + 0x0A + 0x09,
-        12));
-	
+        led_out.add(key, color);
+    }, limit);
 
-    // set our "mode" indicator
-    this->sendMessageSysex(new unsigned char[3]{ 0xB0, static_cast<unsigned char>(mode), 12 }, 3);
-
-    // clear grid
-    // this->sendMessageSysex(commands::led_setAll(0x00));
-    this->clearGrid();
-	
-    // update every LEDs.
-    if (static_cast<size_t>(page) < pages.size()) {
-        // row
-        for (size_t row = 0; row < pages.at(page)->size(); ++row) {
-            // column
-            for (size_t col = 0; col < pages.at(page)->at(row).size(); ++col) {
-                if (pages.at(page) == nullptr) {
-                    continue;
-                }
-
-                config::ButtonBase* button = pages.at(page)->at(row).at(col);
-
-                if (button == nullptr) {
-                    this->sendMessageSysex(commands::led_off(commands::calculate_grid(row, col)));
-                    continue;
-                }
-                // _DebugString(commands::led_set(commands::calculate_grid(row, col));
-                this->sendMessageSysex(
-                    commands::led_set(commands::calculate_grid(row, col),
-                        button->get_color())
-                );
-            }
+    // a whole page fits in two frames (palette + RGB) instead of one message per LED.
+    led_out.flush([this](const unsigned char* frame, size_t size) {
+        this->sendMessage(frame, size);
+    });
 
-        }
-    }
+    return leds.changed() > 0;
+}
+
+// redraws the whole page, but only changed cells hit the wire.
+void midi_device::launchpadmk2::LaunchpadMk2::fullLedUpdate()
+{
+    std::lock_guard<std::mutex> lock(led_mutex);
+
+    this->render();
+    this->compose();
+    writer.wake();
 }
 
 void midi_device::launchpadmk2::LaunchpadMk2::setup_pages_test()
 {
-    launchpad_grid* page = new launchpad_grid{ nullptr };
+    std::lock_guard<std::mutex> pages_lock(pages_mutex);
+    this->publish_test_pages();
+}
+
+// pages_mutex held.
+void midi_device::launchpadmk2::LaunchpadMk2::publish_test_pages()
+{
+    std::shared_ptr<launchpad_pages> table = std::make_shared<launchpad_pages>(mode_count, 1);
+
+    // session mode, page 0 comes first, so the slots are the indices.
 
-    config::ButtonBase* button = new config::ButtonSimpleKeycodeTest(0x41);
-    button->set_color(0x3F3F00);
-    page->at(0)[0] = button;
+    config::Button button = config::ButtonSimpleKeycodeTest(0x41);
+    button.set_color(0x3F3F00);
+    table->put(launchpad_pages::slot(0, 0), button);
 
-    button = new config::ButtonComplexMacro([]() { _DebugString("lol\n"); });
-    button->set_color(0x3F3A00);
-	page->at(7)[6] = button;
+    button = config::ButtonComplexMacro([]() { _DebugString("lol\n"); });
+    button.set_color(0x3F3A00);
+	table->put(launchpad_pages::slot(7, 6), button);
 
 
 https://onlineunicodetools.com/convert-unicode-to-hex use UCS-2-BE
@@ -376,183 +350,120 @@ https://onlineunicodetools.com/convert-unicode-to-hex use UCS-2-BE
             0x0 // null terminator
     };
     std::wstring test = std::wstring(ste);
-    button = new config::ButtonStringMacro(test);
-    button->set_color(0x3A3A00);
-    page->at(7)[5] = button;
+    button = config::ButtonStringMacro(test);
+    button.set_color(0x3A3A00);
+    table->put(launchpad_pages::slot(7, 5), button);
 
     // mute
-    button = new config::ButtonSimpleKeycodeTest(VK_F13);
-    button->set_color(0x3F3F00);
-    page->at(7)[0] = button;
+    button = config::ButtonSimpleKeycodeTest(VK_F13);
+    button.set_color(0x3F3F00);
+    table->put(launchpad_pages::slot(7, 0), button);
 
     // deafen
-    button = new config::ButtonSimpleKeycodeTest(VK_F14);
-    button->set_color(0x3A0000);
-    page->at(7)[1] = button;
+    button = config::ButtonSimpleKeycodeTest(VK_F14);
+    button.set_color(0x3A0000);
+    table->put(launchpad_pages::slot(7, 1), button);
 
-    button = new config::ButtonSimpleKeycodeTest('a');
-    button->set_color(0x3F3F00);
-    page->at(6)[4] = button;
+    button = config::ButtonSimpleKeycodeTest('a');
+    button.set_color(0x3F3F00);
+    table->put(launchpad_pages::slot(6, 4), button);
 
-    pages.push_back(page);
+    pages.publish(table);
+    loader.forget();
 }
 
 void midi_device::launchpadmk2::LaunchpadMk2::load_config_buttons_test() {
-    try {
-        /*if (::config::config_file.at("devices").contains("Launchpad_S")) {
-            return;
-        }*/
-
-        // why
-        if (!::config::config_file.at("devices").at("Launchpad_MK2").is_object()) {
-            return;
-        }
-
-        nlohmann::json& config = ::config::config_file.at("devices").at("Launchpad_MK2");
-        pages.clear();
-        // FIXME: hard limit of 8 pages by buttons but this should be handled better.
-        pages.resize(8);
-
-        for (auto& [page, buttons] : config.at("session").items()) {
-            int index = std::stoi(page);
-            launchpad_grid* page_buttons = new launchpad_grid{ nullptr };
-
-            if (!buttons.is_array()) {
-                _DebugString("lol you're fucked\n");
-            }
-
-            for (auto& button : buttons) {
-                std::string type = button.at("type");
-                int position_x = button.at("position").at(0);
-                int position_y = button.at("position").at(1);
-                unsigned int color = 0x221100;
+    this->load_pages(false);
+}
 
-                config::ButtonBase* new_button;
+// same as the S: the config's pages, or the test page when asked and there's nothing for us in the config.
+void midi_device::launchpadmk2::LaunchpadMk2::load_pages(bool test_pages_otherwise) {
+    std::lock_guard<std::mutex> pages_lock(pages_mutex);
+    std::shared_ptr<const ::config::compiled_config> compiled = ::config::current();
+    const ::config::device_record* device = compiled->find_device("Launchpad_MK2");
 
-                if (type == "key_test") {
-                    if (!button.at("data").is_number()) {
-                        continue;
-                    }
+    if (device == nullptr) {
+        if (test_pages_otherwise)
+            this->publish_test_pages();
+        return;
+    }
 
-                    new_button = new config::ButtonSimpleKeycodeTest(button.at("data"));
+    const ::config::settings& settings = device->device_settings;
 
-                }
-                else if (type == "key_string") {
-                    if (!button.at("data").is_string()) {
-                        continue;
-                    }
+    // some interfaces choke on long sysex, this caps the LED frames.
+    {
+        std::lock_guard<std::mutex> lock(led_mutex);
+        led_out.set_max_size(settings.value(::config::setting::sysex_max_size, commands::led_batch_max_size));
 
-                    new_button = new config::ButtonStringMacro(string_to_wstring(button.at("data")));
-                }
-                else {
-                    new_button = new config::ButtonSimpleKeycodeTest('b');
-                }
+        writer.set_profile({
+            settings.value(::config::setting::output_rate, default_output_profile.bytes_per_second),
+            settings.value(::config::setting::output_burst, default_output_profile.burst_bytes) });
 
-                new_button->set_color(color);
+        // rewrites the top left LED with what it should already show.
+        if (settings.value(::config::setting::calibrate_output, false)) {
+            unsigned int color = leds.get(led_grid_cell(0, 0));
 
-                page_buttons->at(position_x).at(position_y) = new_button;
+            if (color & commands::palette_flag) {
+                auto message = commands::led_setPalette(commands::calculate_grid(0, 0), static_cast<unsigned char>(color & 0x7F));
+                writer.calibrate(message.data(), message.size(), calibration_messages);
+            }
+            else {
+                auto message = commands::led_set(commands::calculate_grid(0, 0), color);
+                writer.calibrate(message.data(), message.size(), calibration_messages);
             }
-
-            pages.at(index) = page_buttons;
         }
     }
-    catch (std::invalid_argument& e) {
-        _DebugString("invalid args!\n");
-    }
-    catch (nlohmann::json::type_error& e) {
-        _DebugString("type error!\n");
-    }
-    catch (nlohmann::json::out_of_range& e) {
-        _DebugString("range error!\n");
+    // FIXME: hard limit of 8 pages by buttons but this should be handled better.
+    constexpr size_t page_count = 8;
+
+    std::vector<size_t> changed;
+    bool incremental = loader.load(pages, compiled, *device, mode_count, page_count, [](const ::config::compiled_config& source, const ::config::button_record& record) {
+        config::Button button = macropad::buttons::make(source, record);
+        button.set_color(0x221100);
+        return button;
+    }, changed);
+
+    // nothing to diff against, repaint it all.
+    if (!incremental) {
+        this->fullLedUpdate();
+        return;
     }
 
-}
-
-void midi_device::launchpadmk2::LaunchpadMk2::TerminateDevice()
-{
-    execute_all = false;
-}
-
-void midi_device::launchpadmk2::config::ButtonSimpleKeycodeTest::execute()
-{
-    if (keycode == -1) {
+    if (changed.empty()) {
         return;
     }
 
-    INPUT input;
-
-    input.type = INPUT_KEYBOARD;
-    input.ki.time = 0;
-    input.ki.wScan = NULL;
-    input.ki.dwExtraInfo = NULL;
-
-    input.ki.wVk = keycode;
-    input.ki.dwFlags = 0;
-
-    // send
-    SendInput(1, &input, sizeof(INPUT));
-
-    // wait
-    Sleep(100);
-
-    // release
-    input.ki.dwFlags = KEYEVENTF_KEYUP;
-    SendInput(1, &input, sizeof(INPUT));
-
-}
-
-void midi_device::launchpadmk2::config::ButtonComplexMacro::execute()
-{
-    this->func();
-}
-
-void midi_device::launchpadmk2::config::ButtonStringMacro::execute()
-{
-    for (const wchar_t a : string) {
-        INPUT input;
-
-        input.type = INPUT_KEYBOARD;
-        input.ki.time = 0;
-        input.ki.wScan = a;
-        input.ki.dwExtraInfo = NULL;
-
-        input.ki.wVk = NULL;
-        input.ki.dwFlags = KEYEVENTF_UNICODE;
+    std::shared_ptr<const launchpad_pages> table = pages.load();
+    std::lock_guard<std::mutex> lock(led_mutex);
 
-        // send
-        SendInput(1, &input, sizeof(INPUT));
+    // only the page showing, any other page is rendered from the new table when it's switched to.
+    // the cells line up with the table, a page is page_slots of them in a row.
+    const size_t showing = mode_index(mode) * page_count + page;
 
-        // wait
-        Sleep(1);
+    for (size_t cell : changed) {
+        if (cell / launchpad_pages::page_slots != showing) {
+            continue;
+        }
 
-        // release
-        input.ki.dwFlags = KEYEVENTF_KEYUP;
-        SendInput(1, &input, sizeof(INPUT));
+        size_t slot = cell % launchpad_pages::page_slots;
+        config::Button* button = table->get(mode_index(mode), page, slot);
+        layers.set_base(led_grid_cell(slot / 8, slot % 8), button == nullptr ? commands::palette(0) : button->get_color());
 
-        Sleep(1);
+        if (button != nullptr)
+            layers.pulse(led_grid_cell(slot / 8, slot % 8), commands::palette(0), button->get_color(), reload_pulse_period_ms, reload_pulse_ms);
     }
-}
 
-std::wstring midi_device::launchpadmk2::config::ButtonStringMacro::to_wstring()
-{
-    return L"midi_device::launchpadmk2::config::ButtonStringMacro : color=" + std::to_wstring(this->get_color()) + L" str=\"" + this->string + L"\"";
+    this->compose();
+    writer.wake();
 }
 
 
-std::wstring midi_device::launchpadmk2::config::ButtonBase::to_wstring()
-{
-    return L"midi_device::launchpadmk2::config::ButtonBase : empty button";
-}
-
-std::wstring midi_device::launchpadmk2::config::ButtonComplexMacro::to_wstring()
+void midi_device::launchpadmk2::LaunchpadMk2::TerminateDevice()
 {
-    std::wstringstream buffer;
-    buffer << std::hex << &this->func;
+    execute_all = false;
 
-    return L"midi_device::launchpadmk2::config::ButtonComplexMacro : color=" + std::to_wstring(this->get_color()) + L" func_ptr=" + buffer.str();
+    // kick the input thread out of waitForMessage.
+    if (main_device != nullptr) {
+        main_device->in->cancelWait();
+    }
 }
-
-std::wstring midi_device::launchpadmk2::config::ButtonSimpleKeycodeTest::to_wstring()
-{
-    return L"midi_device::launchpadmk2::config::ButtonSimpleKeycodeTest : color=" + std::to_wstring(this->get_color()) + L" keycode=" + std::to_wstring(this->keycode);
-}
\ No newline at end of file
@@ -1,8 +1,22 @@
 ﻿#pragma once
 #include "RtMidi.h"
 #include "MidiDevice.h"
+#include "InputEvent.h"
+#include "Button.h"
+#include "KeyInjector.h"
+#include "LedFramebuffer.h"
+#include "LedWriter.h"
+#include "LedLayers.h"
+#include "Animation.h"
+#include "PageTable.h"
 #include <wchar.h>
 #include <functional>
+#include <mutex>
+
+namespace config
+{
+	struct compiled_config;
+}
 
 // the launching of pad mark ii
 namespace midi_device::launchpadmk2
@@ -16,80 +30,214 @@ namespace midi_device::launchpadmk2
 
 	namespace config
 	{
-		class ButtonBase
-		{
-			unsigned int color;
+		// shared with the S, see Button.h.
+		using macropad::buttons::Button;
+		using macropad::buttons::ButtonSimpleKeycodeTest;
+		using macropad::buttons::ComplexMacroFn;
+		using macropad::buttons::ButtonComplexMacro;
+		using macropad::buttons::ButtonStringMacro;
+	}
 
-		public:
-			ButtonBase() : color(0x00FF00) {}
-			virtual ~ButtonBase() {}
-			virtual void execute() = 0;
-			virtual std::wstring to_wstring() = 0;
-			void set_color(unsigned int col) { color = col; }
-			unsigned int get_color() { return color; }
-		};
+	typedef page_table<config::Button> launchpad_pages;
 
-		class ButtonSimpleKeycodeTest : public ButtonBase {
-			int keycode;
-		public:
-			ButtonSimpleKeycodeTest() : keycode(-1) {}
-			ButtonSimpleKeycodeTest(int keycode) : keycode(keycode) {}
-			void execute();
-			std::wstring to_wstring();
-		};
+	// one set of pages per mode.
+	constexpr size_t mode_count = 4;
+	constexpr size_t mode_index(mode current) { return static_cast<size_t>(current); }
 
-		typedef std::function<void()> ComplexMacroFn;
+	// parity
+	extern bool execute_all;
 
-		class ButtonComplexMacro : public ButtonBase {
-			ComplexMacroFn func;
-		public:
-			ButtonComplexMacro(ComplexMacroFn fun) : func(fun) {}
-			void execute();
-			std::wstring to_wstring();
-		};
+	// upper bound on how long the input thread stays parked before re-checking should_loop.
+	constexpr unsigned int input_wait_timeout_ms = 250;
+
+	// input ring capacity. sized for clock messages plus pad mashing between wakeups.
+	constexpr unsigned int input_queue_size = 1024;
+
+	// max messages handled per wakeup.
+	constexpr unsigned int input_batch_size = 64;
+
+	// LED output, the device keeps a batch around so it has to come first.
+	namespace commands
+	{
+		// LED colors are 0xRRGGBB (0 - 63 each), or a palette index with palette_flag set.
+		constexpr unsigned int palette_flag = 0x01000000;
+
+		constexpr unsigned int palette(unsigned char index)
+		{
+			return palette_flag | index;
+		}
+
+		// every sysex message is framed by these.
+		constexpr unsigned char sysex_header[6] = { 0xF0, 0x00, 0x20, 0x29, 0x02, 0x18 };
+		constexpr unsigned char sysex_end = 0xF7;
+
+		// 0x0A/0x0B take up to 80 LEDs in one message.
+		constexpr size_t led_batch_max_entries = 80;
+		// room for a full 0x0B message. anything smaller splits into more frames.
+		constexpr size_t led_batch_max_size = sizeof(sysex_header) + 1 + led_batch_max_entries * 4 + 1;
+
+		// collects LED changes and packs them into as few sysex frames as fit in max_size.
+		class led_batch
+		{
+			// key, palette index
+			std::vector<unsigned char> palette_entries;
+			// key, r, g, b
+			std::vector<unsigned char> rgb_entries;
+			std::vector<unsigned char> frame;
+			size_t max_size;
+
+			template <typename Send>
+			size_t flush_entries(std::vector<unsigned char>& entries, unsigned char command, size_t entry_size, Send& send)
+			{
+				size_t per_frame = (max_size - sizeof(sysex_header) - 2) / entry_size;
+				per_frame = per_frame < 1 ? 1 : per_frame > led_batch_max_entries ? led_batch_max_entries : per_frame;
+
+				size_t frames = 0;
+
+				for (size_t offset = 0; offset < entries.size(); offset += per_frame * entry_size)
+				{
+					size_t bytes = entries.size() - offset < per_frame * entry_size ? entries.size() - offset : per_frame * entry_size;
+
+					frame.assign(std::begin(sysex_header), std::end(sysex_header));
+					frame.push_back(command);
+					frame.insert(frame.end(), entries.begin() + offset, entries.begin() + offset + bytes);
+					frame.push_back(sysex_end);
+
+					send(frame.data(), frame.size());
+					++frames;
+				}
+
+				entries.clear();
+				return frames;
+			}
 
-		class ButtonStringMacro : public ButtonBase {
-			std::wstring string;
 		public:
-			ButtonStringMacro(std::wstring str) : string(str) {}
-			void execute();
-			std::wstring to_wstring();
+			// sized up front so flushing never allocates.
+			led_batch(size_t max_size = led_batch_max_size) : max_size(max_size)
+			{
+				palette_entries.reserve(led_cells * 2);
+				rgb_entries.reserve(led_cells * 4);
+				frame.reserve(led_batch_max_size);
+			}
+
+			// never below one RGB entry per frame.
+			void set_max_size(size_t size) { max_size = size < sizeof(sysex_header) + 6 ? sizeof(sysex_header) + 6 : size; }
+
+			void add(unsigned char key, unsigned int color)
+			{
+				if (color & palette_flag)
+				{
+					palette_entries.insert(palette_entries.end(), { key, static_cast<unsigned char>(color & 0x7F) });
+				}
+				else
+				{
+					rgb_entries.insert(rgb_entries.end(), {
+						key,
+						static_cast<unsigned char>((color & 0xFF0000) >> 16),
+						static_cast<unsigned char>((color & 0x00FF00) >> 8),
+						static_cast<unsigned char>(color & 0x0000FF) });
+				}
+			}
+
+			bool empty() const { return palette_entries.empty() && rgb_entries.empty(); }
+
+			// send(data, size) once per frame. returns the frame count, the batch is empty afterwards.
+			template <typename Send>
+			size_t flush(Send send)
+			{
+				return flush_entries(palette_entries, 0x0A, 2, send) + flush_entries(rgb_entries, 0x0B, 4, send);
+			}
 		};
 	}
 
-	typedef std::array<config::ButtonBase*, 8> launchpad_row;
-	typedef std::array<std::array<config::ButtonBase*, 8>, 8> launchpad_grid;
+	// the MK2 keeps up with a lot more than the S. room for a palette and an RGB frame at once.
+	// "output_rate"/"output_burst" in the config override it, "calibrate_output" measures it.
+	constexpr output_profile default_output_profile = { 10000, 2 * commands::led_batch_max_size };
 
-	// parity
-	extern bool execute_all;
+	// LED messages timed by calibrate_output.
+	constexpr size_t calibration_messages = 200;
+
+	// a released button fades from the press color back to its own over this long.
+	constexpr unsigned int release_fade_ms = 150;
+
+	// a button a reload changed pulses between off and its new color for a bit, so the edit can be seen landing.
+	constexpr unsigned int reload_pulse_period_ms = 400;
+	constexpr unsigned int reload_pulse_ms = 1200;
 
-	class LaunchpadMk2 : public MidiDeviceBase
+	// RGB blends per channel. palette colors can't be blended without the palette, so they switch over halfway,
+	// except palette 0, which is off and blends as black.
+	struct color_mix
+	{
+		unsigned int operator()(unsigned int from, unsigned int to, unsigned int t) const
+		{
+			from = from == commands::palette(0) ? 0 : from;
+			to = to == commands::palette(0) ? 0 : to;
+
+			if ((from | to) & commands::palette_flag)
+				return t < led_mix_max / 2 ? from : to;
+
+			unsigned int result = 0;
+
+			for (unsigned int shift = 0; shift < 24; shift += 8)
+			{
+				unsigned int a = (from >> shift) & 0xFF;
+				unsigned int b = (to >> shift) & 0xFF;
+				result |= ((a * (led_mix_max - t) + b * t + led_mix_max / 2) / led_mix_max) << shift;
+			}
+
+			return result;
+		}
+	};
+
+	class LaunchpadMk2 : public MidiDeviceBase, public macropad::animation::target
 	{
 		inline static LaunchpadMk2* main_device;
 
 		bool should_loop;
 		void Loop();
 		
-		config::ButtonBase* get_button(unsigned char num);
+		config::Button* get_button(const launchpad_pages& table, unsigned char slot);
 
 		mode mode = mode::session;
 		unsigned int page = 0;
 
-		std::vector<launchpad_grid*> pages;
+		// swapped whole by a config (re)load, see PageTable.h.
+		page_table_slot<config::Button> pages;
+		// what the live pages were built from, a reload only rebuilds what differs from it.
+		page_loader<config::Button> loader;
+		// serializes page builds, a reload from the window can overlap the one in Init.
+		std::mutex pages_mutex;
+		void load_pages(bool test_pages_otherwise);
+		void publish_test_pages();
+
+		// see commands::palette for the color format.
+		led_framebuffer<unsigned int> leds;
+		// the page plus effects, composed into leds.
+		led_layers<unsigned int, color_mix> layers;
+		commands::led_batch led_out;
+		// the window thread refreshes too.
+		std::mutex led_mutex;
+		// owns the output port, presentLeds() runs on its thread.
+		led_writer writer{ led_mutex, [this](size_t budget) { return this->presentLeds(budget); }, default_output_profile };
+		void render();
+		void compose();
+		bool presentLeds(size_t budget);
 
 	public:
 		LaunchpadMk2() : should_loop(true)
 		{
-			in = new RtMidiIn();
+			in = new RtMidiIn(RtMidi::UNSPECIFIED, "RtMidi Input Client", input_queue_size);
 			out = new RtMidiOut();
 		}
 
 		void Init();
-		void sendMessage(unsigned char* message);
-		void sendMessage(std::vector<unsigned char> messageOut);
-		void sendMessageSysex(unsigned char* message, size_t size);
-		void sendMessageSysex(std::vector<unsigned char> messageOut);
-		void clearGrid();
+		void sendMessage(const unsigned char* message, size_t size);
+
+		template <size_t N>
+		void sendMessage(const std::array<unsigned char, N>& message)
+		{
+			sendMessage(message.data(), message.size());
+		}
 		void fullLedUpdate();
 		void setup_pages_test();
 
@@ -97,43 +245,58 @@ namespace midi_device::launchpadmk2
 
 		void load_config_buttons_test();
 
-		launchpad_grid* getCurrentButtons()
-		{
-			if (page >= pages.size())
-				return nullptr;
+		bool animate(std::chrono::steady_clock::time_point now) override;
 
-			return pages.at(page);
-		}
+		// the live pages. keep the pointer for as long as buttons out of it are used.
+		std::shared_ptr<const launchpad_pages> getPages() const { return pages.load(); }
+		unsigned int getPage() const { return page; }
+		size_t getModeIndex() const { return mode_index(mode); }
 
 		static void RunDevice();
 		static void TerminateDevice();
 
+		// nullptr until the device is up.
+		// devices holds the MidiDeviceBase part, which isn't at the start of the object (animation::target is
+		// polymorphic and goes first), so this has to be a static_cast.
 		static LaunchpadMk2* GetDevice()
 		{
-			return reinterpret_cast<LaunchpadMk2*>(midi_device::devices.at(0));
+			std::lock_guard<std::mutex> lock(midi_device::devices_mutex);
+			return midi_device::devices.empty() ? nullptr : static_cast<LaunchpadMk2*>(midi_device::devices.at(0));
 		}
 	};
 
-	enum class message_type
+	// REMEMBER bottom left starts with 0x0B!! notes are 0x0A * (row + 1) + column + 1.
+	// column 8 is the arrow column on the right, which we use for pages.
+	constexpr input_key_table make_input_keys()
 	{
-		invalid = 0x0,
-		grid_depressed = 0x90,
-		grid_pressed = 0x90 + 0x7F,
-		grid_page_change_depressed = 0x90 + 0x7F + 0x1,
-		grid_page_change_pressed = 0x90 + 0x7F + 0x2,
-		automap_live_depressed = 0xB0,
-		automap_live_pressed = 0xB0 + 0x7F,
-	};
+		input_key_table table{};
 
-	class input
-	{
-	public:
-		std::vector<unsigned char> message;
+		for (unsigned char row = 0; row < 8; ++row)
+		{
+			for (unsigned char col = 0; col < 9; ++col)
+			{
+				table[0x0A * row + col + 0x0B] = input_key{ col == 8 ? input_kind::page_pressed : input_kind::grid_pressed, row, col, static_cast<unsigned char>(launchpad_pages::slot(row, col)) };
+			}
+		}
 
-		input(std::vector<unsigned char> msg) : message(msg) {};
-		message_type message_type();
-		unsigned char keycode();
-	};
+		add_control_keys(table);
+		return table;
+	}
+
+	inline constexpr input_key_table input_keys = make_input_keys();
+
+	// corners of the grid and the page column, both ways.
+	static_assert(decode_message(input_keys, 0x90, 0x0B, 0x7F).kind == input_kind::grid_pressed
+		&& decode_message(input_keys, 0x90, 0x0B, 0x7F).slot == 0, "0x0B is the bottom left pad");
+	static_assert(decode_message(input_keys, 0x90, 0x58, 0x00).kind == input_kind::grid_released
+		&& decode_message(input_keys, 0x90, 0x58, 0x00).slot == 63, "0x58 is the top right pad");
+	static_assert(decode_message(input_keys, 0x90, 0x13, 0x7F).kind == input_kind::page_pressed
+		&& decode_message(input_keys, 0x90, 0x13, 0x7F).x == 0, "0x13 is page 0");
+	static_assert(decode_message(input_keys, 0x80, 0x59, 0x40).kind == input_kind::page_released
+		&& decode_message(input_keys, 0x80, 0x59, 0x40).x == 7, "0x59 is page 7");
+	static_assert(decode_message(input_keys, 0x90, 0x0A, 0x7F).kind == input_kind::invalid
+		&& decode_message(input_keys, 0x90, 0x5A, 0x7F).kind == input_kind::invalid, "nothing outside the grid");
+	static_assert(decode_message(input_keys, 0xB0, 111, 0x7F).kind == input_kind::control_pressed, "the top row is cc 104 - 111");
 
 	namespace commands
 	{
@@ -153,41 +316,54 @@ namespace midi_device::launchpadmk2
 			y = keycode % 0x0A - 1;
 		}
 
-		// use color palette
-		inline std::vector<unsigned char> led_setPalette(const unsigned char key, const unsigned char color)
+		// a whole sysex message with an N byte payload, header and F7 included. ready to send as is.
+		template <size_t N>
+		using sysex_message = std::array<unsigned char, sizeof(sysex_header) + N + 1>;
+
+		template <size_t N>
+		constexpr sysex_message<N> make_sysex(const std::array<unsigned char, N>& payload)
 		{
-			std::vector<unsigned char> message({ 0x0A, key, color });
+			sysex_message<N> message{};
+
+			for (size_t i = 0; i < sizeof(sysex_header); ++i)
+				message[i] = sysex_header[i];
+
+			for (size_t i = 0; i < N; ++i)
+				message[sizeof(sysex_header) + i] = payload[i];
+
+			message[sizeof(sysex_header) + N] = sysex_end;
 			return message;
 		}
+
+		// use color palette
+		constexpr sysex_message<3> led_setPalette(const unsigned char key, const unsigned char color)
+		{
+			return make_sysex<3>({ 0x0A, key, color });
+		}
 		
-		inline std::vector<unsigned char> led_set(const unsigned char key, const unsigned int color)
+		constexpr sysex_message<5> led_set(const unsigned char key, const unsigned int color)
 		{
-			std::vector<unsigned char> message(
-				{ 0x0B, key,
-					static_cast<unsigned char>((color & 0xFF0000) >> 16),
-					static_cast<unsigned char>((color & 0x00FF00) >> 8),
-					static_cast<unsigned char>(color & 0x0000FF),
-				});
-			return message;
+			return make_sysex<5>({ 0x0B, key,
+				static_cast<unsigned char>((color & 0xFF0000) >> 16),
+				static_cast<unsigned char>((color & 0x00FF00) >> 8),
+				static_cast<unsigned char>(color & 0x0000FF) });
 		}
 
 		// turn off LED
-		inline std::vector<unsigned char> led_off(const unsigned char key)
+		constexpr sysex_message<3> led_off(const unsigned char key)
 		{
 			return led_setPalette(key, 0);
 		}
 
-		constexpr size_t led_setAll_size = 2;
 		// Use palette color values
-		inline unsigned char* led_setAll(unsigned char color)
+		constexpr sysex_message<2> led_setAll(unsigned char color)
 		{
-			return new unsigned char[2]{ 0x0E, color };
+			return make_sysex<2>({ 0x0E, color });
 		}
 
-		inline std::vector<unsigned char> led_setColumn(unsigned char column, unsigned char color)
+		constexpr sysex_message<3> led_setColumn(unsigned char column, unsigned char color)
 		{
-			std::vector<unsigned char> message({ 0x0C, column, color });
-			return message;
+			return make_sysex<3>({ 0x0C, column, color });
 		}
 
 		constexpr unsigned char reset[5] = { 0xB0, 0x00, 0x00, 0x00, 0x00 };
@@ -0,0 +1,110 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstddef>
+
+// what the pad LEDs should show vs what they're showing.
+// devices draw the frame they want into desired, present() sends only the cells that differ from the shadow
+// (the last thing actually sent) and updates it. a page switch costs as many messages as cells that change.
+namespace midi_device {
+	// 8 rows of 9 (the 9th column is the page column on the right), then the 8 round buttons on top.
+	constexpr size_t led_rows = 8;
+	constexpr size_t led_columns = 9;
+	constexpr size_t led_controls = 8;
+	constexpr size_t led_cells = led_rows * led_columns + led_controls;
+
+	constexpr size_t led_grid_cell(size_t row, size_t column) { return row * led_columns + column; }
+	constexpr size_t led_control_cell(size_t index) { return led_rows * led_columns + index; }
+
+	constexpr bool led_is_control(size_t cell) { return cell >= led_rows * led_columns; }
+	constexpr size_t led_cell_row(size_t cell) { return cell / led_columns; }
+	constexpr size_t led_cell_column(size_t cell) { return cell % led_columns; }
+	constexpr size_t led_cell_control(size_t cell) { return cell - led_rows * led_columns; }
+
+	template <typename Color>
+	class led_framebuffer {
+		std::array<Color, led_cells> shadow;
+		std::array<Color, led_cells> desired;
+		// cells whose hardware state we don't know, always sent on the next present().
+		std::bitset<led_cells> stale;
+		// press feedback and the like, sent before anything else.
+		std::bitset<led_cells> urgent;
+
+		bool dirty(size_t cell) const { return stale[cell] || shadow[cell] != desired[cell]; }
+
+		template <typename Send>
+		size_t present_cells(Send& send, size_t limit, bool urgent_only) {
+			size_t count = 0;
+
+			for (size_t cell = 0; cell < led_cells && count < limit; ++cell) {
+				if (urgent_only && !urgent[cell]) {
+					continue;
+				}
+
+				urgent[cell] = false;
+
+				if (!dirty(cell)) {
+					continue;
+				}
+
+				send(cell, desired[cell]);
+				shadow[cell] = desired[cell];
+				stale[cell] = false;
+				++count;
+			}
+
+			return count;
+		}
+
+	public:
+		led_framebuffer() { stale.set(); }
+
+		void set(size_t cell, Color color, bool is_urgent = false) {
+			desired[cell] = color;
+			urgent[cell] = urgent[cell] || is_urgent;
+		}
+		Color get(size_t cell) const { return desired[cell]; }
+		void fill(Color color) { desired.fill(color); }
+
+		// the hardware was cleared to color behind our back (reset, clear-all message).
+		void assume(Color color) {
+			shadow.fill(color);
+			stale.reset();
+		}
+
+		// forget what the hardware shows, the next present() sends everything.
+		void invalidate() { stale.set(); }
+
+		// cells the next present() would send.
+		size_t changed() const {
+			size_t count = 0;
+
+			for (size_t cell = 0; cell < led_cells; ++cell) {
+				count += dirty(cell);
+			}
+
+			return count;
+		}
+
+		// the whole desired frame was sent some other way (rapid update), take it as shown.
+		void commit() {
+			shadow = desired;
+			stale.reset();
+			urgent.reset();
+		}
+
+		// send(cell, color) for every cell that changed, urgent ones first, at most limit of them. whatever
+		// didn't fit stays changed for the next call. returns how many were sent.
+		template <typename Send>
+		size_t present(Send send, size_t limit = led_cells) {
+			size_t count = present_cells(send, limit, true);
+			return count + present_cells(send, limit - count, false);
+		}
+
+		// only the urgent cells.
+		template <typename Send>
+		size_t present_urgent(Send send, size_t limit = led_cells) {
+			return present_cells(send, limit, true);
+		}
+	};
+}
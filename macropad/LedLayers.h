@@ -0,0 +1,208 @@
+#pragma once
+#include "LedFramebuffer.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+// what goes into the framebuffer: the page's own colors (base), with at most one effect per cell on top.
+// devices draw the base, start effects from input (presses, paced typing) and reloads, and compose() both into the
+// framebuffer whenever something changed or on every animation tick while anything is moving. the framebuffer
+// then only sends what differs.
+//
+// Mix is the device's color blend, mix(from, to, t) with t from 0 (from) to led_mix_max (to).
+namespace midi_device {
+	constexpr unsigned int led_mix_max = 256;
+
+	template <typename Color, typename Mix>
+	class led_layers {
+	public:
+		typedef std::chrono::steady_clock clock;
+
+	private:
+		enum class effect_kind : unsigned char {
+			none,
+			// to, until released
+			hold,
+			// fixed blend of base and to, at level
+			level,
+			// from back to base over duration
+			fade,
+			// from, to, from, ... every period, for duration (0 = until stopped)
+			pulse
+		};
+
+		struct effect {
+			effect_kind kind = effect_kind::none;
+			// send ahead of everything else next compose, it's feedback for something the user just did.
+			bool urgent = false;
+			Color from{};
+			Color to{};
+			unsigned int level = 0;
+			unsigned int duration_ms = 0;
+			unsigned int period_ms = 0;
+			clock::time_point start;
+		};
+
+		// a progress bar that fills up by itself, see timed_progress().
+		struct timed_bar {
+			size_t first = 0;
+			size_t length = 0;
+			Color color{};
+			unsigned int duration_ms = 0;
+			clock::time_point start;
+		};
+
+		std::array<Color, led_cells> base{};
+		std::array<effect, led_cells> effects;
+		timed_bar bar;
+		Mix mix;
+
+		static unsigned int elapsed_ms(clock::time_point now, clock::time_point start) {
+			return static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count());
+		}
+
+	public:
+		void fill_base(Color color) { base.fill(color); }
+		void set_base(size_t cell, Color color) { base[cell] = color; }
+		Color get_base(size_t cell) const { return base[cell]; }
+
+		// shows color while held down.
+		void press(size_t cell, Color color) {
+			effects[cell] = effect{ effect_kind::hold, true, color, color, 0, 0, 0, clock::time_point() };
+		}
+
+		// let go of a press, fading back to the base over fade_ms (0 snaps back).
+		void release(size_t cell, unsigned int fade_ms, clock::time_point now = clock::now()) {
+			effect& held = effects[cell];
+
+			if (held.kind != effect_kind::hold || fade_ms == 0) {
+				held = effect{};
+				held.urgent = true;
+				return;
+			}
+
+			fade(cell, held.to, fade_ms, now);
+			effects[cell].urgent = true;
+		}
+
+		void fade(size_t cell, Color from, unsigned int duration_ms, clock::time_point now = clock::now()) {
+			effects[cell] = effect{ effect_kind::fade, false, from, from, 0, duration_ms > 0 ? duration_ms : 1, 0, now };
+		}
+
+		void pulse(size_t cell, Color from, Color to, unsigned int period_ms, unsigned int duration_ms = 0, clock::time_point now = clock::now()) {
+			effects[cell] = effect{ effect_kind::pulse, false, from, to, 0, duration_ms, period_ms > 1 ? period_ms : 2, now };
+		}
+
+		// length cells from first on fill up with color as value goes from 0 to 1, the last one partly.
+		void progress(size_t first, size_t length, Color color, double value) {
+			value = value < 0.0 ? 0.0 : value > 1.0 ? 1.0 : value;
+			unsigned int filled = static_cast<unsigned int>(value * length * led_mix_max);
+
+			for (size_t i = 0; i < length && first + i < led_cells; ++i) {
+				unsigned int cell_level = filled > led_mix_max ? led_mix_max : filled;
+				filled -= cell_level;
+
+				effects[first + i] = effect{ effect_kind::level, false, color, color, cell_level, 0, 0, clock::time_point() };
+			}
+		}
+
+		// progress() going from 0 to 1 over duration_ms by itself, then the cells go back to the base. for things
+		// that take a known time (a paced string). a new one replaces the one running, cells included.
+		void timed_progress(size_t first, size_t length, Color color, unsigned int duration_ms, clock::time_point now = clock::now()) {
+			stop(bar.first, bar.length);
+			bar = timed_bar{ first, length, color, duration_ms > 0 ? duration_ms : 1, now };
+			progress(first, length, color, 0.0);
+		}
+
+		void stop(size_t cell) { effects[cell] = effect{}; }
+
+		void stop(size_t first, size_t length) {
+			for (size_t i = 0; i < length && first + i < led_cells; ++i) {
+				effects[first + i] = effect{};
+			}
+		}
+
+		// anything that changes on its own over time, the animation thread only needs to tick while this is true.
+		bool animating() const {
+			if (bar.length > 0) {
+				return true;
+			}
+
+			for (const effect& current : effects) {
+				if (current.kind == effect_kind::fade || current.kind == effect_kind::pulse) {
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		// base plus effects at now, into the framebuffer's desired frame. returns animating().
+		bool compose(led_framebuffer<Color>& frame, clock::time_point now = clock::now()) {
+			bool moving = false;
+
+			if (bar.length > 0) {
+				unsigned int elapsed = elapsed_ms(now, bar.start);
+
+				if (elapsed >= bar.duration_ms) {
+					stop(bar.first, bar.length);
+					bar = timed_bar{};
+				}
+				else {
+					progress(bar.first, bar.length, bar.color, static_cast<double>(elapsed) / bar.duration_ms);
+					moving = true;
+				}
+			}
+
+			for (size_t cell = 0; cell < led_cells; ++cell) {
+				effect& current = effects[cell];
+				Color color = base[cell];
+
+				switch (current.kind) {
+				case effect_kind::hold:
+					color = current.to;
+					break;
+				case effect_kind::level:
+					color = mix(color, current.to, current.level);
+					break;
+				case effect_kind::fade: {
+					unsigned int elapsed = elapsed_ms(now, current.start);
+
+					if (elapsed >= current.duration_ms) {
+						current.kind = effect_kind::none;
+						break;
+					}
+
+					color = mix(current.from, color, elapsed * led_mix_max / current.duration_ms);
+					moving = true;
+					break;
+				}
+				case effect_kind::pulse: {
+					unsigned int elapsed = elapsed_ms(now, current.start);
+
+					if (current.duration_ms > 0 && elapsed >= current.duration_ms) {
+						current.kind = effect_kind::none;
+						break;
+					}
+
+					// triangle wave, from at the start of each period and to halfway through.
+					unsigned int phase = elapsed % current.period_ms;
+					unsigned int half = current.period_ms / 2;
+					unsigned int t = phase < half ? phase * led_mix_max / half : (current.period_ms - phase) * led_mix_max / (current.period_ms - half);
+
+					color = mix(current.from, current.to, t);
+					moving = true;
+					break;
+				}
+				default:
+					break;
+				}
+
+				frame.set(cell, color, current.urgent);
+				current.urgent = false;
+			}
+
+			return moving;
+		}
+	};
+}
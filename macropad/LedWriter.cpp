@@ -0,0 +1,209 @@
+#ifdef _WIN32
+#include "framework.h"
+#endif
+#include "LedWriter.h"
+#include "Trace.h"
+#include <limits>
+
+void midi_device::led_writer::start(RtMidiOut* port)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (running) {
+		return;
+	}
+
+	out = port;
+	running = true;
+	tokens = profile.burst_bytes;
+	refilled = std::chrono::steady_clock::now();
+	worker = std::thread([this] { this->work(); });
+}
+
+void midi_device::led_writer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (!running) {
+			return;
+		}
+
+		running = false;
+	}
+
+	condition.notify_one();
+	worker.join();
+}
+
+void midi_device::led_writer::wake(bool present)
+{
+	pending = true;
+	present_pending = present_pending || present;
+	condition.notify_one();
+}
+
+void midi_device::led_writer::calibrate(const unsigned char* message, size_t size, size_t repeat)
+{
+	calibration_message.assign(message, message + size);
+	calibration_repeat = repeat;
+	pending = true;
+	condition.notify_one();
+}
+
+void midi_device::led_writer::refill(const output_profile& paced)
+{
+	auto now = std::chrono::steady_clock::now();
+
+	tokens += std::chrono::duration<double>(now - refilled).count() * paced.bytes_per_second;
+	refilled = now;
+
+	if (tokens > paced.burst_bytes) {
+		tokens = paced.burst_bytes;
+	}
+}
+
+// writer thread, unlocked.
+void midi_device::led_writer::send(const unsigned char* message, size_t size)
+{
+	if (!out->isPortOpen()) {
+		return;
+	}
+
+	try {
+		out->sendMessage(message, size);
+	}
+	catch (RtMidiError& error) {
+		error.printMessage();
+#ifdef _WIN32
+		_DebugString(error.getMessage());
+#endif
+	}
+}
+
+// writer thread, locked on entry and exit.
+void midi_device::led_writer::run_calibration(std::unique_lock<std::mutex>& lock)
+{
+	std::vector<unsigned char> message;
+	message.swap(calibration_message);
+	size_t repeat = calibration_repeat;
+	calibration_repeat = 0;
+
+	if (message.empty() || repeat == 0 || out == nullptr || !out->isPortOpen()) {
+		return;
+	}
+
+	lock.unlock();
+
+	auto begin = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < repeat; ++i) {
+		send(message.data(), message.size());
+	}
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	lock.lock();
+
+	if (elapsed <= 0.0) {
+		return;
+	}
+
+	// leave some headroom under what the driver just managed.
+	unsigned int measured = static_cast<unsigned int>(message.size() * repeat / elapsed * 0.8);
+
+	if (profile.bytes_per_second == 0 || measured < profile.bytes_per_second) {
+		profile.bytes_per_second = measured;
+	}
+
+	// the burst just went out, start the bucket empty.
+	tokens = 0.0;
+	refilled = std::chrono::steady_clock::now();
+
+	MACROPAD_TRACE(info, led_calibrated, profile.bytes_per_second, elapsed);
+}
+
+void midi_device::led_writer::work()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	bool last = false;
+
+	while (!last) {
+		if (!backlog) {
+			condition.wait(lock, [this] { return pending || !running; });
+		}
+		else if (profile.bytes_per_second > 0) {
+			// more is waiting in the framebuffer. come back once half a burst has built up, or sooner if woken
+			// (press feedback shouldn't wait behind a repaint).
+			double wait = (profile.burst_bytes / 2.0 - tokens) / profile.bytes_per_second;
+
+			if (wait > 0.0) {
+				condition.wait_for(lock, std::chrono::duration<double>(wait), [this] { return pending || !running; });
+			}
+		}
+
+		// one more round after stop, the final reset has to make it out.
+		last = !running;
+		pending = false;
+
+		if (calibration_repeat > 0) {
+			run_calibration(lock);
+		}
+
+		output_profile paced = profile;
+		refill(paced);
+
+		if (present_pending || backlog) {
+			present_pending = false;
+
+			size_t budget = std::numeric_limits<size_t>::max();
+
+			if (paced.bytes_per_second > 0 && !last) {
+				budget = tokens > queued.bytes() ? static_cast<size_t>(tokens) - queued.bytes() : 0;
+			}
+
+			backlog = collect(budget);
+		}
+
+		if (queued.empty()) {
+			continue;
+		}
+
+		sending.swap(queued);
+
+		// the driver calls can block, nobody else needs the lock for them.
+		lock.unlock();
+
+#if MACROPAD_TRACE_LEVEL > 0
+		// only for the trace below, which isn't there at level 0.
+		auto begin = std::chrono::steady_clock::now();
+#endif
+
+		sending.for_each([this, &paced](const unsigned char* message, size_t size) {
+			if (paced.bytes_per_second > 0) {
+				// raw messages aren't budgeted, they wait here for the bucket instead. anything bigger than a
+				// burst only waits for a full bucket.
+				double needed = size < paced.burst_bytes ? size : paced.burst_bytes;
+
+				refill(paced);
+
+				if (tokens < needed) {
+					std::this_thread::sleep_for(std::chrono::duration<double>((needed - tokens) / paced.bytes_per_second));
+					refill(paced);
+				}
+
+				tokens -= size;
+			}
+
+			send(message, size);
+		});
+
+#if MACROPAD_TRACE_LEVEL > 0
+		MACROPAD_TRACE(verbose, led_flush, static_cast<unsigned int>(sending.size()),
+			std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+#endif
+
+		sending.clear();
+		lock.lock();
+	}
+}
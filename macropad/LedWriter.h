@@ -0,0 +1,153 @@
+#pragma once
+#include "RtMidi.h"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// the one thread that talks to a device's output port. the input and window threads only touch the framebuffer
+// and queue commands under the device's LED lock, then wake the writer. it diffs the framebuffer at that moment,
+// so a cell written five times between two wakeups goes out once, with the last value.
+//
+// output is paced to what the device can take (output_profile). the framebuffer is only diffed as far as the
+// budget goes, the rest waits there, so a big repaint trickles out while press feedback still gets in first.
+namespace midi_device {
+	// whole midi messages back to back in one buffer. reused, so steady state it doesn't allocate.
+	class message_queue {
+		std::vector<unsigned char> data;
+		// end offset of each message
+		std::vector<size_t> ends;
+	public:
+		message_queue()
+		{
+			data.reserve(1024);
+			ends.reserve(128);
+		}
+
+		void push(const unsigned char* message, size_t size)
+		{
+			data.insert(data.end(), message, message + size);
+			ends.push_back(data.size());
+		}
+
+		template <size_t N>
+		void push(const std::array<unsigned char, N>& message) { push(message.data(), message.size()); }
+
+		bool empty() const { return ends.empty(); }
+		size_t size() const { return ends.size(); }
+		size_t bytes() const { return data.size(); }
+
+		void clear()
+		{
+			data.clear();
+			ends.clear();
+		}
+
+		void swap(message_queue& other)
+		{
+			data.swap(other.data);
+			ends.swap(other.ends);
+		}
+
+		// send(data, size) for every message, oldest first.
+		template <typename Send>
+		void for_each(Send send) const
+		{
+			size_t begin = 0;
+
+			for (size_t end : ends)
+			{
+				send(data.data() + begin, end - begin);
+				begin = end;
+			}
+		}
+	};
+
+	// smaller bursts couldn't fit a message plus change, a paced repaint would never get going.
+	constexpr unsigned int min_burst_bytes = 64;
+
+	// how fast a device takes messages without dropping or lagging. counted in message bytes.
+	struct output_profile {
+		// sustained rate. 0 sends as fast as the driver goes.
+		unsigned int bytes_per_second;
+		// what can go out back to back after an idle stretch.
+		unsigned int burst_bytes;
+	};
+
+	class led_writer {
+	public:
+		// called on the writer thread with the LED lock held. presents at most budget bytes of the framebuffer
+		// through post(), returns true if anything was left for later.
+		typedef std::function<bool(size_t budget)> collect_fn;
+
+		led_writer(std::mutex& mutex, collect_fn collect, output_profile profile) : mutex(mutex), collect(collect)
+		{
+			set_profile(profile);
+			tokens = this->profile.burst_bytes;
+		}
+		~led_writer() { stop(); }
+
+		led_writer(const led_writer&) = delete;
+		led_writer& operator=(const led_writer&) = delete;
+
+		void start(RtMidiOut* port);
+		// sends whatever is still queued, then joins.
+		void stop();
+
+		// everything below needs the LED lock held.
+
+		// queue a message. goes out in order, before the framebuffer changes of the same wakeup. never held back
+		// by the budget, only delayed.
+		void post(const unsigned char* message, size_t size) { queued.push(message, size); }
+
+		template <size_t N>
+		void post(const std::array<unsigned char, N>& message) { queued.push(message); }
+
+		// have the writer send the queue. present also runs collect, leave it off when only raw messages changed.
+		void wake(bool present = true);
+
+		void set_profile(output_profile replacement)
+		{
+			profile = replacement;
+			profile.burst_bytes = profile.burst_bytes < min_burst_bytes ? min_burst_bytes : profile.burst_bytes;
+		}
+		output_profile get_profile() const { return profile; }
+
+		// sends message repeat times back to back on the writer thread and times how long the driver takes to
+		// accept them. only means something if the driver blocks once the device falls behind (usb midi does);
+		// the rate only ever goes down from what's configured. message should be harmless to repeat.
+		void calibrate(const unsigned char* message, size_t size, size_t repeat);
+
+	private:
+		std::mutex& mutex;
+		collect_fn collect;
+		std::condition_variable condition;
+		std::thread worker;
+		RtMidiOut* out = nullptr;
+		bool running = false;
+		bool pending = false;
+		bool present_pending = false;
+		output_profile profile;
+
+		std::vector<unsigned char> calibration_message;
+		size_t calibration_repeat = 0;
+
+		// queued is filled under the lock, everything after is only touched by the writer thread.
+		message_queue queued;
+		message_queue sending;
+		// collect couldn't fit everything last time.
+		bool backlog = false;
+		// token bucket, in bytes.
+		double tokens;
+		std::chrono::steady_clock::time_point refilled;
+
+		void work();
+		void refill(const output_profile& paced);
+		void send(const unsigned char* message, size_t size);
+		void run_calibration(std::unique_lock<std::mutex>& lock);
+	};
+}
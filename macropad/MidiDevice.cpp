@@ -4,4 +4,5 @@
 
 namespace midi_device {
 	std::vector<MidiDeviceBase*> devices = std::vector<MidiDeviceBase*>();
+	std::mutex devices_mutex;
 };
\ No newline at end of file
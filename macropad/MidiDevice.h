@@ -1,4 +1,6 @@
 #pragma once
+#include <mutex>
+#include <vector>
 
 namespace midi_device {
 	class MidiDeviceBase {
@@ -9,4 +11,6 @@ namespace midi_device {
 	};
 
 	extern std::vector<MidiDeviceBase*> devices;
+	// device threads add themselves to devices while the window reads it, hold this for either.
+	extern std::mutex devices_mutex;
 }
\ No newline at end of file
@@ -0,0 +1,196 @@
+#pragma once
+#include "Config.h"
+#include "InFlight.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// a device's pages of buttons. a config load builds a whole new table and swaps it in; nothing edits a table
+// once it's published, so the input thread reads it without a lock while a reload runs on another thread.
+// a reload copies over the buttons whose config didn't change, only the rest get built again.
+// a table is one flat array of buttons, (mode, page) after (mode, page), so a press is a single index into it.
+// Button is a value with an empty() state (see Button.h), an empty one is a slot with nothing in it.
+namespace midi_device {
+	template <typename Button>
+	class page_table {
+	public:
+		// 8x8 per page, see slot().
+		static constexpr size_t page_slots = 8 * 8;
+
+	private:
+		size_t modes;
+		size_t pages;
+		size_t count;
+		// every (mode, page) one after the other, page_slots each. this is all a press looks at.
+		// not a vector: a published table is const, and running a button's action isn't.
+		std::unique_ptr<Button[]> slots;
+
+	public:
+		page_table(size_t mode_count = 0, size_t page_count = 0)
+			: modes(mode_count), pages(page_count), count(mode_count * page_count * page_slots), slots(new Button[count]) {}
+		page_table(const page_table&) = delete;
+		page_table& operator=(const page_table&) = delete;
+
+		static constexpr size_t slot(size_t x, size_t y) { return x * 8 + y; }
+
+		size_t mode_count() const { return modes; }
+		size_t page_count() const { return pages; }
+		size_t size() const { return count; }
+
+		// where a slot of a page lives. mode and page have to be in range.
+		size_t index(size_t mode, size_t page, size_t slot) const { return (mode * pages + page) * page_slots + slot; }
+
+		// the page_slots buttons of a page, nullptr if there's no such page.
+		Button* page_buttons(size_t mode, size_t page) const
+		{
+			return mode < modes && page < pages ? slots.get() + index(mode, page, 0) : nullptr;
+		}
+
+		// nullptr for an empty slot too.
+		Button* get(size_t mode, size_t page, size_t slot) const
+		{
+			if (mode >= modes || page >= pages) {
+				return nullptr;
+			}
+
+			Button* button = slots.get() + index(mode, page, slot);
+			return button->empty() ? nullptr : button;
+		}
+
+		// by index, empty or not. nullptr if out of range.
+		const Button* at(size_t index) const { return index < count ? slots.get() + index : nullptr; }
+
+		// only while building, before the table is published. out of range is ignored.
+		void put(size_t at, Button button)
+		{
+			if (at < count) {
+				slots[at] = std::move(button);
+			}
+		}
+	};
+
+	// holds the live table. readers take a reference with load() and keep it for as long as they use buttons
+	// out of it. a swapped out table can still have actions queued or running (a held key, a paced string), so
+	// it's parked until nobody holds it and nothing is in_flight (InFlight.h), then freed by the next reclaim(). publish() tries, and the input loop keeps trying while anything is parked.
+	template <typename Button>
+	class page_table_slot {
+		typedef std::shared_ptr<const page_table<Button>> table_ptr;
+
+		table_ptr current = std::make_shared<const page_table<Button>>();
+		std::mutex retire_mutex;
+		std::vector<table_ptr> retired;
+		// retired isn't empty, so reclaim() can skip the lock when there's nothing to do.
+		std::atomic<bool> parked{ false };
+
+		// retire_mutex held.
+		void reclaim_locked()
+		{
+			// references first: an input thread that posted a job has done so before letting go of its table.
+			// the ones still held stay at the front, the rest go if nothing is in flight.
+			auto unreferenced = std::stable_partition(retired.begin(), retired.end(), [](const table_ptr& table) {
+				return table.use_count() > 1;
+			});
+
+			// use_count() is a relaxed read. this pairs it with the release of the last reference, so a job posted
+			// before that is in the count below.
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			if (unreferenced != retired.end() && macropad::in_flight::none()) {
+				retired.erase(unreferenced, retired.end());
+			}
+
+			parked.store(!retired.empty(), std::memory_order_relaxed);
+		}
+
+	public:
+		table_ptr load() const { return std::atomic_load(&current); }
+
+		void publish(table_ptr table)
+		{
+			std::lock_guard<std::mutex> lock(retire_mutex);
+
+			retired.push_back(std::atomic_exchange(&current, table));
+			reclaim_locked();
+		}
+
+		// frees whatever retired tables it can. never blocks, a reload holding the lock will get to them itself.
+		void reclaim()
+		{
+			if (!parked.load(std::memory_order_relaxed)) {
+				return;
+			}
+
+			std::unique_lock<std::mutex> lock(retire_mutex, std::try_to_lock);
+
+			if (lock.owns_lock()) {
+				reclaim_locked();
+			}
+		}
+	};
+
+	// builds a device's tables from the config and publishes them into its slot. it keeps the config the live
+	// table came from and which record went into each cell, so a reload only builds the buttons whose record
+	// changed. everything else is copied over from the live table, which shares its payload (see Button.h) rather
+	// than building it again. one per device, callers serialize loads (the devices' pages_mutex).
+	template <typename Button>
+	class page_loader {
+		std::shared_ptr<const ::config::compiled_config> source;
+		std::vector<const ::config::button_record*> cells;
+
+	public:
+		// the live table isn't from a config anymore (test pages). the next load() builds everything.
+		void forget()
+		{
+			source = nullptr;
+			cells.clear();
+		}
+
+		// the live table came from a config.
+		bool loaded() const { return source != nullptr; }
+
+		// a new table for device out of config, make(config, record) building the buttons that changed, published
+		// into pages. changed gets the cells (table indices) whose button differs from the live table's. returns
+		// false if there was nothing to go by (first load, test pages before), then every cell is new.
+		template <typename Make>
+		bool load(page_table_slot<Button>& pages, std::shared_ptr<const ::config::compiled_config> config, const ::config::device_record& device,
+			size_t mode_count, size_t page_count, Make make, std::vector<size_t>& changed)
+		{
+			std::vector<const ::config::button_record*> after = ::config::button_cells(*config, device, mode_count, page_count);
+			const bool incremental = source != nullptr && cells.size() == after.size();
+
+			std::shared_ptr<const page_table<Button>> live = pages.load();
+			// built off to the side, input keeps using the live table until publish().
+			std::shared_ptr<page_table<Button>> table = std::make_shared<page_table<Button>>(mode_count, page_count);
+			changed.clear();
+
+			for (size_t cell = 0; cell < after.size(); ++cell) {
+				const ::config::button_record* button = after[cell];
+				const ::config::button_record* was = incremental ? cells[cell] : nullptr;
+
+				if (incremental && (button == nullptr || was == nullptr ? button == was : ::config::same_button(*source, *was, *config, *button))) {
+					// the live table is left alone for whatever of it is still running, this copy shares its payload.
+					if (const Button* kept = live->at(cell)) {
+						table->put(cell, *kept);
+					}
+					continue;
+				}
+
+				changed.push_back(cell);
+
+				if (button != nullptr) {
+					table->put(cell, make(*config, *button));
+				}
+			}
+
+			// let go of the live table first, or publish() sees it still held and can't free it.
+			live.reset();
+			pages.publish(table);
+
+			source = std::move(config);
+			cells = std::move(after);
+			return incremental;
+		}
+	};
+}
@@ -565,7 +565,8 @@ void MidiApi :: error( RtMidiError::Type type, std::string errorString )
 MidiInApi :: MidiInApi( unsigned int queueSizeLimit )
   : MidiApi()
 {
-  // Allocate the MIDI queue.
+  // Allocate the MIDI queue.  Every slot is created up front so the
+  // input handler never allocates for channel messages.
   inputData_.queue.ringSize = queueSizeLimit;
   if ( inputData_.queue.ringSize > 0 )
     inputData_.queue.ring = new MidiMessage[ inputData_.queue.ringSize ];
@@ -634,63 +635,189 @@ double MidiInApi :: getMessage( std::vector<unsigned char> *message )
   return timeStamp;
 }
 
+unsigned int MidiInApi :: getMessages( RtMidiEvent *events, unsigned int maxEvents )
+{
+  if ( inputData_.usingCallback ) {
+    errorString_ = "RtMidiIn::getMessages: a user callback is currently set for this port.";
+    error( RtMidiError::WARNING, errorString_ );
+    return 0;
+  }
+
+  return inputData_.queue.popBatch( events, maxEvents );
+}
+
+bool MidiInApi :: waitForMessage( unsigned int timeoutMs )
+{
+  if ( inputData_.usingCallback ) {
+    errorString_ = "RtMidiIn::waitForMessage: a user callback is currently set for this port.";
+    error( RtMidiError::WARNING, errorString_ );
+    return false;
+  }
+
+  return inputData_.queue.wait( timeoutMs );
+}
+
+void MidiInApi :: cancelWait( void )
+{
+  inputData_.queue.cancelWait();
+}
+
+double MidiInApi :: getWakeLatency( void )
+{
+  return inputData_.queue.wakeLatency.load( std::memory_order_relaxed );
+}
+
+unsigned long MidiInApi :: getOverflowCount( void )
+{
+  return inputData_.queue.overflowCount.load( std::memory_order_relaxed );
+}
+
 unsigned int MidiInApi::MidiQueue::size( unsigned int *__back,
                                          unsigned int *__front )
 {
-  // Access back/front members exactly once and make stack copies for
-  // size calculation
-  unsigned int _back = back, _front = front, _size;
+  // Load back/front exactly once.  Each side calls this for the index
+  // it does not own, so the acquire pairs with the other side's release.
+  unsigned int _back = back.load( std::memory_order_acquire );
+  unsigned int _front = front.load( std::memory_order_acquire );
+  unsigned int _size;
   if ( _back >= _front )
     _size = _back - _front;
   else
     _size = ringSize - _front + _back;
 
-  // Return copies of back/front so no new and unsynchronized accesses
-  // to member variables are needed.
+  // Return copies of back/front so no new accesses to the atomics are needed.
   if ( __back ) *__back = _back;
   if ( __front ) *__front = _front;
   return _size;
 }
 
 // As long as we haven't reached our queue size limit, push the message.
+// Only ever called from the input handler thread.
 bool MidiInApi::MidiQueue::push( const MidiInApi::MidiMessage& msg )
 {
-  // Local stack copies of front/back
-  unsigned int _back, _front, _size;
+  if ( ringSize < 2 ) {
+    overflowCount.fetch_add( 1, std::memory_order_relaxed );
+    return false;
+  }
 
-  // Get back/front indexes exactly once and calculate current size
-  _size = size( &_back, &_front );
+  unsigned int _back = back.load( std::memory_order_relaxed );
+  unsigned int next = ( _back + 1 ) % ringSize;
 
-  if ( _size < ringSize-1 )
-  {
-    ring[_back] = msg;
-    back = (back+1)%ringSize;
-    return true;
+  // Full: the consumer has not released the slot we would write to.
+  if ( next == front.load( std::memory_order_acquire ) ) {
+    overflowCount.fetch_add( 1, std::memory_order_relaxed );
+    return false;
   }
 
-  return false;
+  // Copying into the slot never allocates for channel messages and
+  // reuses the slot's sysex capacity otherwise.
+  ring[_back] = msg;
+
+  lastPush.store( std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed );
+
+  // seq_cst so this store and the waiting check below cannot be
+  // reordered against the consumer's waiting store and its seq_cst
+  // load of back in wait().  Either we see waiting or it sees the
+  // message.
+  back.store( next, std::memory_order_seq_cst );
+
+  if ( waiting.load( std::memory_order_seq_cst ) ) {
+    // Taking the lock closes the window between the consumer's
+    // predicate check and it actually blocking.
+    { std::lock_guard<std::mutex> lock( waitMutex ); }
+    waitCondition.notify_one();
+  }
+  return true;
 }
 
+// Only ever called from the consumer thread.
 bool MidiInApi::MidiQueue::pop( std::vector<unsigned char> *msg, double* timeStamp )
 {
-  // Local stack copies of front/back
-  unsigned int _back, _front, _size;
-
-  // Get back/front indexes exactly once and calculate current size
-  _size = size( &_back, &_front );
+  unsigned int _front = front.load( std::memory_order_relaxed );
 
-  if ( _size == 0 )
+  // Empty.
+  if ( _front == back.load( std::memory_order_acquire ) )
     return false;
 
   // Copy queued message to the vector pointer argument and then "pop" it.
   msg->assign( ring[_front].bytes.begin(), ring[_front].bytes.end() );
   *timeStamp = ring[_front].timeStamp;
 
-  // Update front
-  front = (front+1)%ringSize;
+  // Hand the slot back to the producer.
+  front.store( ( _front + 1 ) % ringSize, std::memory_order_release );
   return true;
 }
 
+// Drain up to maxEvents short messages with one acquire of back and
+// one release of front.  Stops before the first message that does not
+// fit an RtMidiEvent.  Only ever called from the consumer thread.
+unsigned int MidiInApi::MidiQueue::popBatch( RtMidiEvent *events, unsigned int maxEvents )
+{
+  if ( ringSize == 0 ) return 0;
+
+  unsigned int _front = front.load( std::memory_order_relaxed );
+  unsigned int _back = back.load( std::memory_order_acquire );
+  unsigned int count = 0;
+
+  while ( _front != _back && count < maxEvents ) {
+    const MidiMessage& msg = ring[_front];
+    if ( msg.bytes.size() > sizeof( events[count].bytes ) ) break;
+
+    RtMidiEvent& event = events[count++];
+    event.size = (unsigned char) msg.bytes.size();
+    for ( unsigned int i=0; i<event.size; ++i ) event.bytes[i] = msg.bytes[i];
+    event.timeStamp = msg.timeStamp;
+
+    _front = ( _front + 1 ) % ringSize;
+  }
+
+  // Hand all drained slots back to the producer at once.
+  if ( count > 0 ) front.store( _front, std::memory_order_release );
+  return count;
+}
+
+// Park the calling thread until a message is queued, cancelWait() is
+// called or the timeout expires.  Returns true if a message is ready.
+bool MidiInApi::MidiQueue::wait( unsigned int timeoutMs )
+{
+  // Already something there, nothing was waited for.
+  if ( size() > 0 ) {
+    wakeLatency.store( 0.0, std::memory_order_relaxed );
+    return true;
+  }
+
+  // back has to be a seq_cst load once waiting is set: an acquire load
+  // may be ordered before the waiting store, and then neither side sees
+  // the other and the wakeup is lost until the timeout.  front is ours.
+  auto queued = [this] {
+    return back.load( std::memory_order_seq_cst ) != front.load( std::memory_order_relaxed );
+  };
+
+  std::unique_lock<std::mutex> lock( waitMutex );
+  waiting.store( true, std::memory_order_seq_cst );
+
+  bool ready = waitCondition.wait_for( lock, std::chrono::milliseconds( timeoutMs ),
+                                       [this, &queued] { return waitCancelled || queued(); } );
+  waiting.store( false, std::memory_order_relaxed );
+  waitCancelled = false;
+
+  if ( !ready || !queued() ) return false;
+
+  std::chrono::steady_clock::duration sincePush( std::chrono::steady_clock::now().time_since_epoch().count() -
+                                                 lastPush.load( std::memory_order_relaxed ) );
+  wakeLatency.store( std::chrono::duration<double>( sincePush ).count(), std::memory_order_relaxed );
+  return true;
+}
+
+void MidiInApi::MidiQueue::cancelWait( void )
+{
+  {
+    std::lock_guard<std::mutex> lock( waitMutex );
+    waitCancelled = true;
+  }
+  waitCondition.notify_all();
+}
+
 //*********************************************************************//
 //  Common MidiOutApi Definitions
 //*********************************************************************//
@@ -801,12 +928,13 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
         // If not a continuing sysex message, invoke the user callback function or queue the message.
         if ( data->usingCallback ) {
           RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
-          callback( message.timeStamp, &message.bytes, data->userData );
+          data->callbackBytes.assign( message.bytes.begin(), message.bytes.end() );
+          callback( message.timeStamp, &data->callbackBytes, data->userData );
         }
         else {
           // As long as we haven't reached our queue size limit, push the message.
-          if ( !data->queue.push( message ) )
-            std::cerr << "\nMidiInCore: message queue limit reached!!\n\n";
+          // Overflows are counted by the queue (see getOverflowCount).
+          data->queue.push( message );
         }
         message.bytes.clear();
       }
@@ -860,12 +988,13 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
             // If not a continuing sysex message, invoke the user callback function or queue the message.
             if ( data->usingCallback ) {
               RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
-              callback( message.timeStamp, &message.bytes, data->userData );
+              data->callbackBytes.assign( message.bytes.begin(), message.bytes.end() );
+              callback( message.timeStamp, &data->callbackBytes, data->userData );
             }
             else {
               // As long as we haven't reached our queue size limit, push the message.
-              if ( !data->queue.push( message ) )
-                std::cerr << "\nMidiInCore: message queue limit reached!!\n\n";
+              // Overflows are counted by the queue (see getOverflowCount).
+              data->queue.push( message );
             }
             message.bytes.clear();
           }
@@ -1638,7 +1767,7 @@ static void *alsaMidiHandler( void *ptr )
         if ( !continueSysex )
           message.bytes.assign( buffer, &buffer[nBytes] );
         else
-          message.bytes.insert( message.bytes.end(), buffer, &buffer[nBytes] );
+          message.bytes.append( buffer, &buffer[nBytes] );
 
         continueSysex = ( ( ev->type == SND_SEQ_EVENT_SYSEX ) && ( message.bytes.back() != 0xF7 ) );
         if ( !continueSysex ) {
@@ -1697,12 +1826,13 @@ static void *alsaMidiHandler( void *ptr )
 
     if ( data->usingCallback ) {
       RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
-      callback( message.timeStamp, &message.bytes, data->userData );
+      data->callbackBytes.assign( message.bytes.begin(), message.bytes.end() );
+      callback( message.timeStamp, &data->callbackBytes, data->userData );
     }
     else {
       // As long as we haven't reached our queue size limit, push the message.
-      if ( !data->queue.push( message ) )
-        std::cerr << "\nMidiInAlsa: message queue limit reached!!\n\n";
+      // Overflows are counted by the queue (see getOverflowCount).
+      data->queue.push( message );
     }
   }
 
@@ -2397,6 +2527,7 @@ struct WinMidiData {
   DWORD lastTime;
   MidiInApi::MidiMessage message;
   LPMIDIHDR sysexBuffer[RT_SYSEX_BUFFER_COUNT];
+  std::vector<char> sysexOut;  // reused by MidiOutWinMM::sendMessage, grows to the largest message sent
   CRITICAL_SECTION _mutex; // [Patrice] see https://groups.google.com/forum/#!topic/mididev/6OUjHutMpEo
 };
 
@@ -2450,16 +2581,16 @@ static void CALLBACK midiInputCallback( HMIDIIN /*hmin*/,
       return;
     }
 
-    // Copy bytes to our MIDI message.
+    // Copy bytes to our MIDI message (inline, no allocation).
     unsigned char *ptr = (unsigned char *) &midiMessage;
-    for ( int i=0; i<nBytes; ++i ) apiData->message.bytes.push_back( *ptr++ );
+    apiData->message.bytes.assign( ptr, ptr + nBytes );
   }
   else { // Sysex message ( MIM_LONGDATA or MIM_LONGERROR )
     MIDIHDR *sysex = ( MIDIHDR *) midiMessage;
     if ( !( data->ignoreFlags & 0x01 ) && inputStatus != MIM_LONGERROR ) {
       // Sysex message and we're not ignoring it
-      for ( int i=0; i<(int)sysex->dwBytesRecorded; ++i )
-        apiData->message.bytes.push_back( sysex->lpData[i] );
+      unsigned char *sysexData = (unsigned char *) sysex->lpData;
+      apiData->message.bytes.append( sysexData, sysexData + sysex->dwBytesRecorded );
     }
 
     // The WinMM API requires that the sysex buffer be requeued after
@@ -2488,12 +2619,13 @@ static void CALLBACK midiInputCallback( HMIDIIN /*hmin*/,
 
   if ( data->usingCallback ) {
     RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
-    callback( apiData->message.timeStamp, &apiData->message.bytes, data->userData );
+    data->callbackBytes.assign( apiData->message.bytes.begin(), apiData->message.bytes.end() );
+    callback( apiData->message.timeStamp, &data->callbackBytes, data->userData );
   }
   else {
     // As long as we haven't reached our queue size limit, push the message.
-    if ( !data->queue.push( apiData->message ) )
-      std::cerr << "\nMidiInWinMM: message queue limit reached!!\n\n";
+    // Overflows are counted by the queue (see getOverflowCount).
+    data->queue.push( apiData->message );
   }
 
   // Clear the vector for the next input message.
@@ -2856,16 +2988,9 @@ void MidiOutWinMM :: sendMessage( const unsigned char *message, size_t size )
   WinMidiData *data = static_cast<WinMidiData *> (apiData_);
   if ( message[0] == 0xF0 ) { // Sysex message
 
-    // Allocate buffer for sysex data.
-    char *buffer = (char *) malloc( nBytes );
-    if ( buffer == NULL ) {
-      errorString_ = "MidiOutWinMM::sendMessage: error allocating sysex message memory!";
-      error( RtMidiError::MEMORY_ERROR, errorString_ );
-      return;
-    }
-
-    // Copy data to buffer.
-    for ( unsigned int i=0; i<nBytes; ++i ) buffer[i] = message[i];
+    // Copy data to the reused buffer. midiOutLongMsg is done with it once the header is unprepared below.
+    data->sysexOut.assign( message, message + nBytes );
+    char *buffer = data->sysexOut.data();
 
     // Create and prepare MIDIHDR structure.
     MIDIHDR sysex;
@@ -2874,7 +2999,6 @@ void MidiOutWinMM :: sendMessage( const unsigned char *message, size_t size )
     sysex.dwFlags = 0;
     result = midiOutPrepareHeader( data->outHandle,  &sysex, sizeof( MIDIHDR ) );
     if ( result != MMSYSERR_NOERROR ) {
-      free( buffer );
       errorString_ = "MidiOutWinMM::sendMessage: error preparing sysex header.";
       error( RtMidiError::DRIVER_ERROR, errorString_ );
       return;
@@ -2883,7 +3007,6 @@ void MidiOutWinMM :: sendMessage( const unsigned char *message, size_t size )
     // Send the message.
     result = midiOutLongMsg( data->outHandle, &sysex, sizeof( MIDIHDR ) );
     if ( result != MMSYSERR_NOERROR ) {
-      free( buffer );
       errorString_ = "MidiOutWinMM::sendMessage: error sending sysex message.";
       error( RtMidiError::DRIVER_ERROR, errorString_ );
       return;
@@ -2891,7 +3014,6 @@ void MidiOutWinMM :: sendMessage( const unsigned char *message, size_t size )
 
     // Unprepare the buffer and MIDIHDR.
     while ( MIDIERR_STILLPLAYING == midiOutUnprepareHeader( data->outHandle, &sysex, sizeof ( MIDIHDR ) ) ) Sleep( 1 );
-    free( buffer );
   }
   else { // Channel or system message.
 
@@ -3029,12 +3151,13 @@ static int jackProcessIn( jack_nframes_t nframes, void *arg )
       // invoke the user callback function or queue the message.
       if ( rtData->usingCallback ) {
         RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) rtData->userCallback;
-        callback( message.timeStamp, &message.bytes, rtData->userData );
+        rtData->callbackBytes.assign( message.bytes.begin(), message.bytes.end() );
+        callback( message.timeStamp, &rtData->callbackBytes, rtData->userData );
       }
       else {
         // As long as we haven't reached our queue size limit, push the message.
-        if ( !rtData->queue.push( message ) )
-          std::cerr << "\nMidiInJack: message queue limit reached!!\n\n";
+        // Overflows are counted by the queue (see getOverflowCount).
+        rtData->queue.push( message );
       }
     }
   }
@@ -64,6 +64,10 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
 
 /************************************************************************/
 /*! \class RtMidiError
@@ -127,6 +131,20 @@ class RTMIDI_DLL_PUBLIC RtMidiError : public std::exception
  */
 typedef void (*RtMidiErrorCallback)( RtMidiError::Type type, const std::string &errorText, void *userData );
 
+//! A fixed-size MIDI message as filled in by RtMidiIn::getMessages().
+/*!
+    Holds any channel or system common/real-time message (at most 3
+    bytes).  Sysex messages do not fit and are left in the input queue
+    for RtMidiIn::getMessage().
+ */
+struct RtMidiEvent {
+  unsigned char bytes[3];
+  unsigned char size;
+
+  //! Time in seconds elapsed since the previous message
+  double timeStamp;
+};
+
 class MidiApi;
 
 class RTMIDI_DLL_PUBLIC RtMidi
@@ -260,7 +278,7 @@ class RTMIDI_DLL_PUBLIC RtMidiIn : public RtMidi
     error occurs.  The queue size defines the maximum number of
     messages that can be held in the MIDI queue (when not using a
     callback function).  If the queue size limit is reached,
-    incoming messages will be ignored.
+    incoming messages will be ignored and counted (see getOverflowCount).
 
     If no API argument is specified and multiple API support has been
     compiled, the default order of use is ALSA, JACK (Linux) and CORE,
@@ -366,6 +384,43 @@ class RTMIDI_DLL_PUBLIC RtMidiIn : public RtMidi
   */
   double getMessage( std::vector<unsigned char> *message );
 
+  //! Move every pending message that fits an RtMidiEvent into the user-provided buffer and return how many were written.
+  /*!
+    Up to \e maxEvents messages are drained with a single update of the
+    input queue.  Draining stops early at a sysex message; fetch that one
+    with \e getMessage.  A return value of zero with \e waitForMessage
+    reporting data therefore means a sysex message is next in the queue.
+    Like \e getMessage, this returns immediately and is not available
+    while a user callback is set.
+  */
+  unsigned int getMessages( RtMidiEvent *events, unsigned int maxEvents );
+
+  //! Block the calling thread until a message is available in the input queue.
+  /*!
+    The thread is parked (not spinning) until the input handler queues
+    a message, \e cancelWait is called or \e timeoutMs milliseconds
+    have passed.  Returns true if a message can be retrieved with the
+    \e getMessage function.  Not available while a user callback is set.
+  */
+  bool waitForMessage( unsigned int timeoutMs );
+
+  //! Wake a thread blocked in \e waitForMessage.
+  /*!
+    If no thread is currently waiting, the next call to
+    \e waitForMessage returns immediately.
+  */
+  void cancelWait( void );
+
+  //! Return the time in seconds between the last queued message and the waiting thread waking up for it.
+  /*!
+    Zero if the last waitForMessage() found a message already queued and
+    did not wait.
+  */
+  double getWakeLatency( void );
+
+  //! Return the number of incoming messages dropped because the input queue was full.
+  unsigned long getOverflowCount( void );
+
   //! Set an error callback function to be invoked when an error has occured.
   /*!
     The callback function will be called whenever an error has occured. It is best
@@ -539,32 +594,117 @@ class RTMIDI_DLL_PUBLIC MidiInApi : public MidiApi
   void cancelCallback( void );
   virtual void ignoreTypes( bool midiSysex, bool midiTime, bool midiSense );
   double getMessage( std::vector<unsigned char> *message );
+  unsigned int getMessages( RtMidiEvent *events, unsigned int maxEvents );
+  bool waitForMessage( unsigned int timeoutMs );
+  void cancelWait( void );
+  double getWakeLatency( void );
+  unsigned long getOverflowCount( void );
+
+  // Byte storage for a single incoming MIDI message.  Channel and
+  // system messages (at most 3 bytes) live inline in the object; only
+  // sysex spills into the heap buffer.  The spill buffer keeps its
+  // capacity across clear() and assignment, so every MidiBytes acts as
+  // a pooled sysex buffer once it has seen one sysex message.
+  class MidiBytes {
+   public:
+    static const unsigned int inlineSize = 3;
+
+    MidiBytes() : size_(0) {}
+    MidiBytes( const MidiBytes& other ) : size_(0) { *this = other; }
+    MidiBytes& operator=( const MidiBytes& other ) { assign( other.begin(), other.end() ); return *this; }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    void clear() { size_ = 0; spill_.clear(); }
+
+    unsigned char *data() { return size_ <= inlineSize ? inline_ : spill_.data(); }
+    const unsigned char *data() const { return size_ <= inlineSize ? inline_ : spill_.data(); }
+    const unsigned char *begin() const { return data(); }
+    const unsigned char *end() const { return data() + size_; }
+    unsigned char& operator[]( size_t i ) { return data()[i]; }
+    const unsigned char& operator[]( size_t i ) const { return data()[i]; }
+    unsigned char back() const { return data()[size_ - 1]; }
+
+    void push_back( unsigned char byte )
+    {
+      if ( size_ < inlineSize ) {
+        inline_[size_++] = byte;
+        return;
+      }
+      // Moving past the inline bytes: carry them over to the spill buffer.
+      if ( size_ == inlineSize ) spill_.assign( inline_, inline_ + inlineSize );
+      spill_.push_back( byte );
+      ++size_;
+    }
+
+    void assign( const unsigned char *first, const unsigned char *last )
+    {
+      size_t n = last - first;
+      if ( n <= inlineSize ) {
+        for ( size_t i=0; i<n; ++i ) inline_[i] = first[i];
+        spill_.clear();
+      }
+      else spill_.assign( first, last );
+      size_ = (unsigned int) n;
+    }
+
+    void append( const unsigned char *first, const unsigned char *last )
+    {
+      for ( ; first != last; ++first ) push_back( *first );
+    }
+
+   private:
+    unsigned char inline_[inlineSize];
+    unsigned int size_;
+    std::vector<unsigned char> spill_;
+  };
 
   // A MIDI structure used internally by the class to store incoming
   // messages.  Each message represents one and only one MIDI message.
   struct MidiMessage {
-    std::vector<unsigned char> bytes;
+    MidiBytes bytes;
 
     //! Time in seconds elapsed since the previous message
     double timeStamp;
 
     // Default constructor.
     MidiMessage()
-      : bytes(0), timeStamp(0.0) {}
+      : bytes(), timeStamp(0.0) {}
   };
 
+  // Lock-free single-producer (the input handler) / single-consumer
+  // (getMessage) ring of preallocated messages.  The producer only
+  // writes back and the consumer only writes front; slot contents are
+  // published by the release store of the index and picked up by the
+  // acquire load on the other side.
   struct MidiQueue {
-    unsigned int front;
-    unsigned int back;
+    std::atomic<unsigned int> front;
+    std::atomic<unsigned int> back;
     unsigned int ringSize;
     MidiMessage *ring;
 
+    // Messages dropped because the ring was full.
+    std::atomic<unsigned long> overflowCount;
+
+    // Used to park a consumer in wait() until push() has something for it.
+    // push() only takes the lock when a consumer is actually parked.
+    std::mutex waitMutex;
+    std::condition_variable waitCondition;
+    std::atomic<bool> waiting;
+    bool waitCancelled;
+    std::atomic<long long> lastPush;
+    std::atomic<double> wakeLatency;
+
     // Default constructor.
     MidiQueue()
-      : front(0), back(0), ringSize(0), ring(0) {}
+      : front(0), back(0), ringSize(0), ring(0), overflowCount(0),
+        waiting(false), waitCancelled(false), lastPush(0), wakeLatency(0.0) {}
     bool push( const MidiMessage& );
     bool pop( std::vector<unsigned char>*, double* );
+    unsigned int popBatch( RtMidiEvent*, unsigned int );
     unsigned int size( unsigned int *back=0, unsigned int *front=0 );
+    bool wait( unsigned int timeoutMs );
+    void cancelWait( void );
   };
 
   // The RtMidiInData structure is used to pass private class data to
@@ -572,6 +712,8 @@ class RTMIDI_DLL_PUBLIC MidiInApi : public MidiApi
   struct RtMidiInData {
     MidiQueue queue;
     MidiMessage message;
+    // Scratch vector handed to the user callback, reused between messages.
+    std::vector<unsigned char> callbackBytes;
     unsigned char ignoreFlags;
     bool doInput;
     bool firstMessage;
@@ -617,6 +759,11 @@ inline unsigned int RtMidiIn :: getPortCount( void ) { return rtapi_->getPortCou
 inline std::string RtMidiIn :: getPortName( unsigned int portNumber ) { return rtapi_->getPortName( portNumber ); }
 inline void RtMidiIn :: ignoreTypes( bool midiSysex, bool midiTime, bool midiSense ) { static_cast<MidiInApi *>(rtapi_)->ignoreTypes( midiSysex, midiTime, midiSense ); }
 inline double RtMidiIn :: getMessage( std::vector<unsigned char> *message ) { return static_cast<MidiInApi *>(rtapi_)->getMessage( message ); }
+inline unsigned int RtMidiIn :: getMessages( RtMidiEvent *events, unsigned int maxEvents ) { return static_cast<MidiInApi *>(rtapi_)->getMessages( events, maxEvents ); }
+inline bool RtMidiIn :: waitForMessage( unsigned int timeoutMs ) { return static_cast<MidiInApi *>(rtapi_)->waitForMessage( timeoutMs ); }
+inline void RtMidiIn :: cancelWait( void ) { static_cast<MidiInApi *>(rtapi_)->cancelWait(); }
+inline double RtMidiIn :: getWakeLatency( void ) { return static_cast<MidiInApi *>(rtapi_)->getWakeLatency(); }
+inline unsigned long RtMidiIn :: getOverflowCount( void ) { return static_cast<MidiInApi *>(rtapi_)->getOverflowCount(); }
 inline void RtMidiIn :: setErrorCallback( RtMidiErrorCallback errorCallback, void *userData ) { rtapi_->setErrorCallback(errorCallback, userData); }
 
 inline RtMidi::Api RtMidiOut :: getCurrentApi( void ) throw() { return rtapi_->getCurrentApi(); }
@@ -0,0 +1,275 @@
+#ifdef _WIN32
+#include "framework.h"
+#include <mmsystem.h>
+#endif
+#include "InFlight.h"
+#include "Scheduler.h"
+#include "Trace.h"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace macropad::scheduler {
+    namespace {
+        constexpr unsigned int wheel_bits = 8;
+        constexpr unsigned int wheel_size = 1 << wheel_bits;
+        constexpr unsigned int wheel_mask = wheel_size - 1;
+
+        // end of a timer list.
+        constexpr unsigned int none = 0xFFFFFFFF;
+
+        struct timer {
+            unsigned long long deadline;
+            callback fn;
+            void* context;
+            std::uintptr_t arg;
+            unsigned int next;
+        };
+
+        // timers in the order they went in. appending at the tail keeps same-deadline timers first in, first out
+        // and the due list in deadline order, however late the worker wakes.
+        struct timer_list {
+            unsigned int head = none;
+            unsigned int tail = none;
+        };
+
+        // everything below is guarded by mutex.
+        std::array<timer, capacity> timers;
+        // order doesn't matter here, a plain stack.
+        unsigned int free_list = none;
+        std::array<timer_list, wheel_size> level0;
+        std::array<timer_list, wheel_size> level1;
+
+        // next tick to process, in ms since epoch.
+        unsigned long long current_tick = 0;
+        size_t pending_count = 0;
+
+        std::chrono::steady_clock::time_point epoch;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool running = false;
+        std::thread worker;
+
+        unsigned long long now_tick() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch).count();
+        }
+
+        void push(unsigned int& head, unsigned int index) {
+            timers[index].next = head;
+            head = index;
+        }
+
+        void append(timer_list& list, unsigned int index) {
+            timers[index].next = none;
+
+            if (list.head == none) {
+                list.head = index;
+            }
+            else {
+                timers[list.tail].next = index;
+            }
+
+            list.tail = index;
+        }
+
+        // moves all of from to the end of to.
+        void splice(timer_list& to, timer_list& from) {
+            if (from.head == none) {
+                return;
+            }
+
+            if (to.head == none) {
+                to.head = from.head;
+            }
+            else {
+                timers[to.tail].next = from.head;
+            }
+
+            to.tail = from.tail;
+            from = timer_list{};
+        }
+
+        // file a timer into whichever wheel slot is responsible for its deadline.
+        void insert(unsigned int index) {
+            unsigned long long deadline = timers[index].deadline;
+
+            if (deadline < current_tick) {
+                deadline = timers[index].deadline = current_tick;
+            }
+
+            unsigned long long round = deadline >> wheel_bits;
+            unsigned long long current_round = current_tick >> wheel_bits;
+
+            if (round == current_round) {
+                append(level0[deadline & wheel_mask], index);
+            }
+            else if (round - current_round < wheel_size) {
+                append(level1[round & wheel_mask], index);
+            }
+            else {
+                // too far out. park it in the last slot we can see; it gets re-filed from there.
+                append(level1[(current_round + wheel_size - 1) & wheel_mask], index);
+            }
+        }
+
+        // moves the timers due at current_tick to the end of the due list.
+        void advance(timer_list& due) {
+            // start of a new level 0 round: spread the matching level 1 slot over level 0, in order.
+            if ((current_tick & wheel_mask) == 0) {
+                unsigned int list = level1[(current_tick >> wheel_bits) & wheel_mask].head;
+                level1[(current_tick >> wheel_bits) & wheel_mask] = timer_list{};
+
+                while (list != none) {
+                    unsigned int next = timers[list].next;
+                    insert(list);
+                    list = next;
+                }
+            }
+
+            splice(due, level0[current_tick & wheel_mask]);
+
+            ++current_tick;
+        }
+
+        void work() {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            while (running) {
+                if (pending_count == 0) {
+                    // schedule() moves current_tick up to date before filing the first timer.
+                    condition.wait(lock, [] { return pending_count > 0 || !running; });
+                    continue;
+                }
+
+                timer_list due;
+                unsigned long long now = now_tick();
+
+                while (current_tick <= now) {
+                    advance(due);
+                }
+
+                if (due.head != none) {
+                    // run without the lock so callbacks can schedule follow-up steps.
+                    lock.unlock();
+
+                    for (unsigned int index = due.head; index != none; index = timers[index].next) {
+                        timers[index].fn(timers[index].context, timers[index].arg);
+                    }
+
+                    lock.lock();
+
+                    while (due.head != none) {
+                        unsigned int next = timers[due.head].next;
+                        push(free_list, due.head);
+                        --pending_count;
+                        in_flight::end();
+                        due.head = next;
+                    }
+                }
+
+                condition.wait_until(lock, epoch + std::chrono::milliseconds(current_tick));
+            }
+
+            // shutting down: fire whatever is left now, a held key has to come back up. the rest of this round
+            // first, then the later rounds, so it's still in order apart from within a level 1 slot.
+            timer_list due;
+
+            for (unsigned int i = static_cast<unsigned int>(current_tick & wheel_mask); i < wheel_size; ++i) {
+                splice(due, level0[i]);
+            }
+
+            for (unsigned int i = 1; i <= wheel_size; ++i) {
+                splice(due, level1[((current_tick >> wheel_bits) + i) & wheel_mask]);
+            }
+
+            lock.unlock();
+
+            for (unsigned int index = due.head; index != none; index = timers[index].next) {
+                timers[index].fn(timers[index].context, timers[index].arg);
+                in_flight::end();
+            }
+        }
+    }
+
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (running) {
+            return;
+        }
+
+        free_list = none;
+        for (unsigned int i = capacity; i-- > 0;) {
+            push(free_list, i);
+        }
+
+        level0.fill(timer_list{});
+        level1.fill(timer_list{});
+        pending_count = 0;
+
+        epoch = std::chrono::steady_clock::now();
+        current_tick = 0;
+
+#ifdef _WIN32
+        // default windows timer resolution is ~15 ms, way too coarse for key timing.
+        timeBeginPeriod(1);
+#endif
+
+        running = true;
+        worker = std::thread(work);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (!running) {
+                return;
+            }
+
+            running = false;
+        }
+
+        condition.notify_all();
+        worker.join();
+
+#ifdef _WIN32
+        timeEndPeriod(1);
+#endif
+    }
+
+    bool schedule(unsigned int delay_ms, callback fn, void* context, std::uintptr_t arg) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (!running || free_list == none) {
+                MACROPAD_TRACE(error, timer_dropped, static_cast<unsigned int>(pending_count), 0.0);
+                return false;
+            }
+
+            unsigned int index = free_list;
+            free_list = timers[index].next;
+
+            // nearest tick rather than truncating, keeps the wheel's own error within half a tick either way.
+            unsigned long long now_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+            timers[index].deadline = (now_us + delay_ms * 1000ull + 500) / 1000;
+            timers[index].fn = fn;
+            timers[index].context = context;
+            timers[index].arg = arg;
+
+            // the wheel is empty, so skipping ahead over an idle stretch is free.
+            if (pending_count == 0) {
+                current_tick = now_tick();
+            }
+
+            insert(index);
+            ++pending_count;
+            in_flight::begin();
+        }
+
+        condition.notify_one();
+        return true;
+    }
+}
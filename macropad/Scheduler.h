@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// one thread running timed steps (key ups, delays between characters, ...) off a hierarchical timer wheel.
+// 1 ms ticks. level 0 covers the current 256 ms, level 1 the next 256 of those; anything further is parked
+// in the last level 1 slot and re-filed when it comes around.
+// callbacks run on the scheduler thread, keep them short. nothing ever sleeps on an executor thread anymore.
+namespace macropad::scheduler {
+    typedef void (*callback)(void* context, std::uintptr_t arg);
+
+    // timers are preallocated, this is how many can be pending at once.
+    constexpr size_t capacity = 4096;
+
+    void start();
+    void stop();
+
+    // run fn(context, arg) delay_ms from now. returns false if every timer is in use or the scheduler isn't running.
+    // a timer is in_flight until its callback returned.
+    bool schedule(unsigned int delay_ms, callback fn, void* context, std::uintptr_t arg = 0);
+}
@@ -0,0 +1,189 @@
+#ifdef _WIN32
+#include "framework.h"
+#endif
+#include "Trace.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+
+namespace macropad::trace {
+    namespace {
+        constexpr size_t ring_mask = ring_size - 1;
+
+        // sequence tells producers/the consumer whose turn the slot is.
+        struct slot {
+            std::atomic<size_t> sequence;
+            record data;
+        };
+        static_assert((ring_size & ring_mask) == 0, "trace ring size has to be a power of two");
+
+        // bounded MPSC ring (per-slot sequence numbers, see Vyukov's bounded queue).
+        struct ring_buffer {
+            std::array<slot, ring_size> slots;
+            std::atomic<size_t> enqueue_pos{ 0 };
+            size_t dequeue_pos = 0;
+
+            ring_buffer() {
+                for (size_t i = 0; i < ring_size; ++i) {
+                    slots[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+        };
+
+        ring_buffer ring;
+        std::atomic<unsigned long long> dropped_records{ 0 };
+
+        std::thread drain_thread;
+        std::atomic<bool> running{ false };
+        std::ofstream file_out;
+
+        constexpr const char* event_names[] = {
+            "midi_in",
+            "input_wake",
+            "input_overflow",
+            "sysex_ignored",
+            "action_dropped",
+            "timer_dropped",
+            "inject_short",
+            "led_flush",
+            "led_calibrated",
+            "animation_over_budget"
+        };
+        static_assert(sizeof(event_names) / sizeof(event_names[0]) == static_cast<size_t>(event::count), "missing trace event name");
+
+        void output(const std::string& line) {
+#ifdef _WIN32
+            _DebugString(line);
+#else
+            std::fputs(line.c_str(), stderr);
+#endif
+        }
+
+        bool pop(record& out) {
+            slot& s = ring.slots[ring.dequeue_pos & ring_mask];
+
+            if (s.sequence.load(std::memory_order_acquire) != ring.dequeue_pos + 1) {
+                return false;
+            }
+
+            out = s.data;
+            // hand the slot back to producers one lap ahead.
+            s.sequence.store(ring.dequeue_pos + ring_size, std::memory_order_release);
+            ++ring.dequeue_pos;
+            return true;
+        }
+
+        void format(const record& r, char* buffer, size_t size) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::duration(r.ticks)).count();
+            const char* name = event_names[static_cast<size_t>(r.id)];
+
+            switch (r.id) {
+            case event::midi_in:
+                std::snprintf(buffer, size, "[%.6f] %s %02X %02X %02X stamp = %f\n", seconds, name,
+                    (r.arg >> 16) & 0xFF, (r.arg >> 8) & 0xFF, r.arg & 0xFF, r.value);
+                break;
+            case event::input_wake:
+                std::snprintf(buffer, size, "[%.6f] %s batch = %u, wake = %f\n", seconds, name, r.arg, r.value);
+                break;
+            default:
+                std::snprintf(buffer, size, "[%.6f] %s %u\n", seconds, name, r.arg);
+                break;
+            }
+        }
+
+        void drain() {
+            record r;
+            char line[128];
+
+            while (pop(r)) {
+                format(r, line, sizeof(line));
+                output(line);
+
+                if (file_out.is_open()) {
+                    file_out << line;
+                }
+            }
+
+            if (file_out.is_open()) {
+                file_out.flush();
+            }
+        }
+
+        void drain_loop() {
+            while (running.load(std::memory_order_acquire)) {
+                drain();
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+
+            // whatever came in while shutting down.
+            drain();
+        }
+    }
+
+    void write(level lvl, event id, unsigned int arg, double value) noexcept {
+        size_t pos = ring.enqueue_pos.load(std::memory_order_relaxed);
+        slot* s;
+
+        for (;;) {
+            s = &ring.slots[pos & ring_mask];
+            size_t sequence = s->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+            if (diff == 0) {
+                if (ring.enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                // full. never stall the caller for a trace line.
+                dropped_records.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else {
+                pos = ring.enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        s->data.ticks = std::chrono::steady_clock::now().time_since_epoch().count();
+        s->data.value = value;
+        s->data.arg = arg;
+        s->data.id = id;
+        s->data.lvl = lvl;
+        s->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    void start(const std::filesystem::path& file) {
+        if (MACROPAD_TRACE_LEVEL == 0 || running.exchange(true)) {
+            return;
+        }
+
+        if (!file.empty()) {
+            file_out.open(file, std::ios::out | std::ios::trunc);
+        }
+
+        drain_thread = std::thread(drain_loop);
+    }
+
+    void stop() {
+        if (!running.exchange(false)) {
+            return;
+        }
+
+        drain_thread.join();
+
+        if (dropped_records.load() > 0) {
+            output("trace: dropped " + std::to_string(dropped_records.load()) + " records\n");
+        }
+
+        file_out.close();
+    }
+
+    unsigned long long dropped() {
+        return dropped_records.load(std::memory_order_relaxed);
+    }
+}
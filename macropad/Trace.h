@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+
+// compile time trace level. anything above it compiles to nothing.
+// 0 = off, 1 = errors, 2 = info, 3 = verbose (every input message).
+#ifndef MACROPAD_TRACE_LEVEL
+#ifdef _DEBUG
+#define MACROPAD_TRACE_LEVEL 3
+#else
+#define MACROPAD_TRACE_LEVEL 0
+#endif
+#endif
+
+// fixed-size binary records go into a lock-free ring; a background thread turns them into text.
+// writers never block, if the ring is full the record is dropped and counted.
+namespace macropad::trace {
+    enum class level : unsigned char {
+        error = 1,
+        info,
+        verbose
+    };
+
+    enum class event : unsigned char {
+        // arg = packed status/data bytes, value = delta time stamp
+        midi_in,
+        // arg = messages in the batch, value = wake latency (s)
+        input_wake,
+        // arg = total dropped so far
+        input_overflow,
+        // arg = sysex size
+        sysex_ignored,
+        // arg = jobs pending when the action was dropped
+        action_dropped,
+        // arg = timers pending when the step was dropped
+        timer_dropped,
+        // arg = key events that didn't get injected (or errno when the injector couldn't open)
+        inject_short,
+        // arg = messages sent in one LED writer wakeup, value = time spent in the driver (s)
+        led_flush,
+        // arg = calibrated output rate (bytes/s), value = time the calibration burst took (s)
+        led_calibrated,
+        // arg = tick cost (us), value = the interval it got stretched to (s)
+        animation_over_budget,
+        count
+    };
+
+    struct record {
+        long long ticks;
+        double value;
+        unsigned int arg;
+        event id;
+        level lvl;
+    };
+
+    // power of two.
+    constexpr size_t ring_size = 4096;
+
+    inline unsigned int pack(unsigned char a, unsigned char b, unsigned char c) {
+        return (a << 16) | (b << 8) | c;
+    }
+
+    void write(level lvl, event id, unsigned int arg, double value) noexcept;
+
+    // starts the drain thread. output goes to the debug output and, if given, a file.
+    void start(const std::filesystem::path& file = std::filesystem::path());
+    void stop();
+
+    unsigned long long dropped();
+}
+
+#if MACROPAD_TRACE_LEVEL > 0
+#define MACROPAD_TRACE(lvl, id, arg, value) \
+    do { \
+        if constexpr (static_cast<int>(::macropad::trace::level::lvl) <= MACROPAD_TRACE_LEVEL) \
+            ::macropad::trace::write(::macropad::trace::level::lvl, ::macropad::trace::event::id, (arg), (value)); \
+    } while (0)
+#else
+#define MACROPAD_TRACE(lvl, id, arg, value) do { } while (0)
+#endif
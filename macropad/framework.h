@@ -24,15 +24,14 @@
 #include "macropad.h"
 
 
-inline std::wstring string_to_wstring(std::string convert) {
+inline std::wstring string_to_wstring(const std::string& convert) {
+    if (convert.empty())
+        return std::wstring();
+
     // used to find the buffer size you need for the wide string.
-    int buffer_size = MultiByteToWideChar(CP_UTF8, 0, convert.c_str(), -1, nullptr, 0);
-    // new obj
-    wchar_t* buffer = new wchar_t[buffer_size];
-    // convert.
-    MultiByteToWideChar(CP_UTF8, 0, convert.c_str(), -1, buffer, buffer_size);
-    // get the result
-    std::wstring result = std::wstring(buffer);
-    delete[] buffer;
+    int buffer_size = MultiByteToWideChar(CP_UTF8, 0, convert.data(), static_cast<int>(convert.size()), nullptr, 0);
+    // convert straight into the result.
+    std::wstring result(static_cast<size_t>(buffer_size), L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, convert.data(), static_cast<int>(convert.size()), &result[0], buffer_size);
     return result;
 }
\ No newline at end of file
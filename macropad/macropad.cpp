@@ -5,7 +5,13 @@
 #include "macropad.h"
 #include "Launchpad.h"
 #include "Config.h"
+#include "Trace.h"
+#include "Executor.h"
+#include "Scheduler.h"
+#include "Animation.h"
+#include "ConfigWatcher.h"
 #include <array>
+#include <mutex>
 #include <Dbt.h>
 
 namespace macropad {
@@ -68,6 +74,7 @@ namespace macropad {
             CW_USEDEFAULT, CW_USEDEFAULT, 1010, 650, nullptr, nullptr, hInstance, nullptr);
 
         HWND hWindForm = CreateDialog(hInst, MAKEINTRESOURCE(IDD_FORMVIEW), hWnd, FormDlgProc);
+        hMainForm = hWindForm;
 
         if (!(hWnd || hWindForm))
         {
@@ -95,6 +102,13 @@ namespace macropad {
         {
         case WM_INITDIALOG:
             return TRUE;
+        case WM_CONFIG_CHANGED:
+            // no device yet, it builds from the new config itself when it starts. otherwise only the buttons that
+            // changed are rebuilt and repainted.
+            if (midi_device::launchpad::Launchpad* device = midi_device::launchpad::Launchpad::GetDevice()) {
+                device->load_config_buttons_test();
+            }
+            return TRUE;
         case WM_COMMAND:
             switch (LOWORD(wParam))
             {
@@ -119,14 +133,9 @@ namespace macropad {
                 midi_device::launchpad::Launchpad::GetDevice()->setup_pages_test();
                 break;
             case IDC_CONFIG_RELOAD: {
-                if (config::file_handle != INVALID_HANDLE_VALUE) {
-                    CloseHandle(config::file_handle);
+                if (macropad::LoadConfig()) {
+                    PostMessage(hdlg, WM_CONFIG_CHANGED, 0, 0);
                 }
-
-                config::openFileHandle();
-                config::loadFile();
-                CloseHandle(config::file_handle);
-
                 break;
             }
             case IDC_CONFIG_RELOAD2: {
@@ -225,25 +234,28 @@ namespace macropad {
 
 
 void macropad::RefreshButtonList() {
-    midi_device::launchpad::launchpad_grid* buttons = midi_device::launchpad::Launchpad::GetDevice()->getCurrentButtons();
+    midi_device::launchpad::Launchpad* device = midi_device::launchpad::Launchpad::GetDevice();
+    // keeps the buttons alive while we print them, even if a reload swaps the pages out.
+    std::shared_ptr<const midi_device::launchpad::launchpad_pages> pages = device->getPages();
+    midi_device::launchpad::config::Button* buttons = pages->page_buttons(device->getModeIndex(), device->getPage());
 
     ClearButtonList();
 
     if (buttons != nullptr) {
-        for (size_t x = 0; x < buttons->size(); x++) {
-            for (size_t y = 0; y < buttons->at(x).size(); y++) {
-                midi_device::launchpad::config::ButtonBase* button = buttons->at(x).at(y);
-                std::wstring str = std::to_wstring(midi_device::launchpad::commands::calculate_grid(x, y)) + L" | x= " + std::to_wstring(x) + L" y= " + std::to_wstring(y) + L" | ";
-
-                if (button == nullptr) {
-                    str += L"null button";
-                }
-                else {
-                    str += button->to_wstring();
-                }
-
-                ListBox_AddString(macropad::hList_debug_help, str.c_str());
+        for (size_t slot = 0; slot < midi_device::launchpad::launchpad_pages::page_slots; slot++) {
+            size_t x = slot / 8;
+            size_t y = slot % 8;
+            const midi_device::launchpad::config::Button& button = buttons[slot];
+            std::wstring str = std::to_wstring(midi_device::launchpad::commands::calculate_grid(x, y)) + L" | x= " + std::to_wstring(x) + L" y= " + std::to_wstring(y) + L" | ";
+
+            if (button.empty()) {
+                str += L"null button";
+            }
+            else {
+                str += button.to_wstring();
             }
+
+            ListBox_AddString(macropad::hList_debug_help, str.c_str());
         }
     }
     else {
@@ -258,6 +270,35 @@ void macropad::ClearButtonList() {
     }
 }
 
+bool macropad::LoadConfig()
+{
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::shared_ptr<const config::compiled_config> previous = config::current();
+
+    if (config::file_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(config::file_handle);
+    }
+
+    config::openFileHandle();
+    config::loadFile();
+    CloseHandle(config::file_handle);
+    config::file_handle = INVALID_HANDLE_VALUE;
+
+    std::shared_ptr<const config::compiled_config> compiled = config::current();
+
+    // unchanged, or it didn't load and we keep the old one.
+    if (compiled == previous) {
+        return false;
+    }
+
+    macropad::animation::configure(
+        compiled->global.value(config::setting::animation_fps, macropad::animation::default_fps),
+        compiled->global.value(config::setting::animation_cpu_budget, macropad::animation::default_cpu_budget));
+    return true;
+}
+
 void macropad::RefreshDevicesList()
 {
     for (int i = ComboBox_GetCount(macropad::hCombo_Midi_Ins); i >= 0; i--) {
@@ -326,6 +367,22 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
 
     MSG msg;
 
+    macropad::trace::start();
+    macropad::executor::start();
+    macropad::scheduler::start();
+    macropad::animation::start();
+
+    // before the devices start, they build their pages from it. usually straight from the snapshot.
+    macropad::LoadConfig();
+
+    // from here on saving config.json is enough. parsing happens on the watcher thread, the devices swap their
+    // new pages in whole, input never waits on any of it.
+    config::watcher::start(config::file_path, [] {
+        if (macropad::LoadConfig()) {
+            PostMessage(macropad::hMainForm, macropad::WM_CONFIG_CHANGED, 0, 0);
+        }
+    });
+
     std::thread launchpad_thread(midi_device::launchpad::Launchpad::RunDevice);
 
     // Main message loop:
@@ -338,9 +395,18 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
         }
     }
 
+    config::watcher::stop();
+
     midi_device::launchpad::Launchpad::TerminateDevice();
     launchpad_thread.join();
 
+    macropad::animation::stop();
+
+    // executor first, a running macro may still schedule steps.
+    macropad::executor::stop();
+    macropad::scheduler::stop();
+    macropad::trace::stop();
+
     return (int)msg.wParam;
 }
 
@@ -35,6 +35,13 @@ namespace macropad {
     void ClearButtonList();
 
     void RefreshDevicesList();
+
+    // (re)loads config.json and applies the global settings. devices pick theirs up in load_config_buttons_test.
+    // true if the config changed since the last load. the window and the config watcher both call it.
+    bool LoadConfig();
+
+    // posted to the form after a reload brought in a new config, the devices rebuild their pages from it.
+    constexpr UINT WM_CONFIG_CHANGED = WM_APP + 1;
 }
 
 void _DebugString(std::wstring s);